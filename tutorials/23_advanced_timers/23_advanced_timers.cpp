@@ -1,13 +1,15 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//Using SDL, SDL_image, SDL_ttf, standard IO, strings, string streams, lists, and maps
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <list>
+#include <map>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -16,6 +18,78 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Texture memory kept for rendered text
+const size_t TEXT_CACHE_BUDGET = 4 * 1024 * 1024;
+
+#ifdef _SDL_TTF_H
+//Keeps rendered text textures around so unchanged strings aren't rendered again
+class LTextCache
+{
+	public:
+		//Initializes variables
+		LTextCache( size_t byteBudget );
+
+		//Deallocates memory
+		~LTextCache();
+
+		//Gets the texture for a string, rendering it only if it isn't cached
+		//The texture stays valid until it's released
+		SDL_Texture* acquire( TTF_Font* font, const std::string& text, SDL_Color color, int& width, int& height );
+
+		//Lets an acquired texture be freed once it's the least recently used
+		void release( SDL_Texture* texture );
+
+		//Deallocates every cached texture
+		void free();
+
+		//Gets cache statistics
+		int getHits();
+		int getMisses();
+		size_t getBytes();
+
+	private:
+		//What a rendered string depends on
+		struct Key
+		{
+			TTF_Font* font;
+			std::string text;
+			Uint32 color;
+			int style;
+
+			bool operator<( const Key& other ) const;
+		};
+
+		//A rendered string
+		struct Entry
+		{
+			Key key;
+			SDL_Texture* texture;
+			int width;
+			int height;
+			size_t bytes;
+			int users;
+		};
+
+		//Frees least recently used textures nobody holds until the cache is within budget
+		void trim();
+
+		//Entries from most to least recently used
+		std::list<Entry> mEntries;
+
+		//Finds entries by what they render and by their texture
+		std::map<Key, std::list<Entry>::iterator> mByKey;
+		std::map<SDL_Texture*, std::list<Entry>::iterator> mByTexture;
+
+		//Texture memory allowed and in use
+		size_t mBudget;
+		size_t mBytes;
+
+		//Lookup counts
+		int mHits;
+		int mMisses;
+};
+#endif
+
 //Texture wrapper class
 class LTexture
 {
@@ -30,8 +104,9 @@ class LTexture
 		bool loadFromFile( std::string path );
 		
 		#ifdef _SDL_TTF_H
-		//Creates image from font string
-		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
+		//Creates image from font string, cached text shares the texture with other copies of the same text
+		//Leave text that changes every frame uncached, it would never be reused
+		bool loadFromRenderedText( std::string textureText, SDL_Color textColor, bool cached = true );
 		#endif
 
 		//Deallocates texture
@@ -57,6 +132,9 @@ class LTexture
 		//The actual hardware texture
 		SDL_Texture* mTexture;
 
+		//Whether the texture belongs to the text cache
+		bool mCached;
+
 		//Image dimensions
 		int mWidth;
 		int mHeight;
@@ -112,15 +190,20 @@ SDL_Renderer* gRenderer = NULL;
 //Globally used font
 TTF_Font* gFont = NULL;
 
+//Rendered text shared between textures
+LTextCache gTextCache( TEXT_CACHE_BUDGET );
+
 //Scene textures
 LTexture gTimeTextTexture;
 LTexture gPausePromptTexture;
 LTexture gStartPromptTexture;
+LTexture gCacheStatsTexture;
 
 LTexture::LTexture()
 {
 	//Initialize
 	mTexture = NULL;
+	mCached = false;
 	mWidth = 0;
 	mHeight = 0;
 }
@@ -173,37 +256,45 @@ bool LTexture::loadFromFile( std::string path )
 }
 
 #ifdef _SDL_TTF_H
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
+bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor, bool cached )
 {
 	//Get rid of preexisting texture
 	free();
 
+	//Get the text from the cache, rendering it if it isn't there
+	if( cached )
+	{
+		mTexture = gTextCache.acquire( gFont, textureText, textColor, mWidth, mHeight );
+		mCached = mTexture != NULL;
+	}
 	//Render text surface
-	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
-	if( textSurface != NULL )
+	else
 	{
-		//Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if( mTexture == NULL )
+		SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
+		if( textSurface != NULL )
 		{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+			//Create texture from surface pixels
+			mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+			if( mTexture == NULL )
+			{
+				printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+			}
+			else
+			{
+				//Get image dimensions
+				mWidth = textSurface->w;
+				mHeight = textSurface->h;
+			}
+
+			//Get rid of old surface
+			SDL_FreeSurface( textSurface );
 		}
 		else
 		{
-			//Get image dimensions
-			mWidth = textSurface->w;
-			mHeight = textSurface->h;
+			printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
 		}
-
-		//Get rid of old surface
-		SDL_FreeSurface( textSurface );
-	}
-	else
-	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
 	}
 
-	
 	//Return success
 	return mTexture != NULL;
 }
@@ -214,8 +305,17 @@ void LTexture::free()
 	//Free texture if it exists
 	if( mTexture != NULL )
 	{
-		SDL_DestroyTexture( mTexture );
+		//Cached text is only handed back
+		if( mCached )
+		{
+			gTextCache.release( mTexture );
+		}
+		else
+		{
+			SDL_DestroyTexture( mTexture );
+		}
 		mTexture = NULL;
+		mCached = false;
 		mWidth = 0;
 		mHeight = 0;
 	}
@@ -265,6 +365,167 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+#ifdef _SDL_TTF_H
+bool LTextCache::Key::operator<( const Key& other ) const
+{
+	//Order by the cheap fields first
+	if( font != other.font )
+	{
+		return font < other.font;
+	}
+	if( color != other.color )
+	{
+		return color < other.color;
+	}
+	if( style != other.style )
+	{
+		return style < other.style;
+	}
+	return text < other.text;
+}
+
+LTextCache::LTextCache( size_t byteBudget )
+{
+	//Initialize
+	mBudget = byteBudget;
+	mBytes = 0;
+	mHits = 0;
+	mMisses = 0;
+}
+
+LTextCache::~LTextCache()
+{
+	//Deallocate
+	free();
+}
+
+SDL_Texture* LTextCache::acquire( TTF_Font* font, const std::string& text, SDL_Color color, int& width, int& height )
+{
+	Key key;
+	key.font = font;
+	key.text = text;
+	key.color = ( color.r << 24 ) | ( color.g << 16 ) | ( color.b << 8 ) | color.a;
+	key.style = TTF_GetFontStyle( font );
+
+	//Reuse the cached texture and mark it most recently used
+	std::map<Key, std::list<Entry>::iterator>::iterator found = mByKey.find( key );
+	if( found != mByKey.end() )
+	{
+		++mHits;
+		mEntries.splice( mEntries.begin(), mEntries, found->second );
+		Entry& entry = mEntries.front();
+		++entry.users;
+		width = entry.width;
+		height = entry.height;
+		return entry.texture;
+	}
+	++mMisses;
+
+	//The final texture
+	SDL_Texture* newTexture = NULL;
+
+	//Render text surface
+	SDL_Surface* textSurface = TTF_RenderText_Solid( font, text.c_str(), color );
+	if( textSurface != NULL )
+	{
+		//Create texture from surface pixels
+		newTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+		if( newTexture == NULL )
+		{
+			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Remember it as the most recently used
+			Entry entry;
+			entry.key = key;
+			entry.texture = newTexture;
+			entry.width = textSurface->w;
+			entry.height = textSurface->h;
+			entry.bytes = (size_t)textSurface->w * textSurface->h * 4;
+			entry.users = 1;
+			mEntries.push_front( entry );
+			mByKey[ key ] = mEntries.begin();
+			mByTexture[ newTexture ] = mEntries.begin();
+			mBytes += entry.bytes;
+
+			width = entry.width;
+			height = entry.height;
+
+			//Make room for it
+			trim();
+		}
+
+		//Get rid of old surface
+		SDL_FreeSurface( textSurface );
+	}
+	else
+	{
+		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+	}
+
+	return newTexture;
+}
+
+void LTextCache::release( SDL_Texture* texture )
+{
+	std::map<SDL_Texture*, std::list<Entry>::iterator>::iterator found = mByTexture.find( texture );
+	if( found != mByTexture.end() && found->second->users > 0 )
+	{
+		--found->second->users;
+
+		//It might have been the only thing keeping the cache over budget
+		trim();
+	}
+}
+
+void LTextCache::free()
+{
+	//Free textures
+	for( std::list<Entry>::iterator i = mEntries.begin(); i != mEntries.end(); ++i )
+	{
+		SDL_DestroyTexture( i->texture );
+	}
+	mEntries.clear();
+	mByKey.clear();
+	mByTexture.clear();
+	mBytes = 0;
+}
+
+int LTextCache::getHits()
+{
+	return mHits;
+}
+
+int LTextCache::getMisses()
+{
+	return mMisses;
+}
+
+size_t LTextCache::getBytes()
+{
+	return mBytes;
+}
+
+void LTextCache::trim()
+{
+	//Walk up from the least recently used, textures still held can't go
+	std::list<Entry>::iterator i = mEntries.end();
+	while( mBytes > mBudget && i != mEntries.begin() )
+	{
+		--i;
+		if( i->users == 0 )
+		{
+			SDL_DestroyTexture( i->texture );
+			mBytes -= i->bytes;
+			mByKey.erase( i->key );
+			mByTexture.erase( i->texture );
+			i = mEntries.erase( i );
+		}
+	}
+}
+#endif
+
 LTimer::LTimer()
 {
     //Initialize the variables
@@ -477,6 +738,10 @@ void close()
 	gTimeTextTexture.free();
 	gStartPromptTexture.free();
 	gPausePromptTexture.free();
+	gCacheStatsTexture.free();
+
+	//Free cached text
+	gTextCache.free();
 
 	//Free global font
 	TTF_CloseFont( gFont );
@@ -503,8 +768,9 @@ SDL_Color textColor = { 0, 0, 0, 255 };
 //The application timer
 LTimer timer;
 
-//In memory text stream
+//In memory text streams
 std::stringstream timeText;
+std::stringstream statsText;
 
 void loop_handler(void*)
 {
@@ -551,12 +817,21 @@ void loop_handler(void*)
 	timeText.str( "" );
 	timeText << "Seconds since start time " << ( timer.getTicks() / 1000.f ) ; 
 
-	//Render text
-	if( !gTimeTextTexture.loadFromRenderedText( timeText.str().c_str(), textColor ) )
+	//Render text, only caching it while it stays the same from frame to frame
+	bool timeChanging = timer.isStarted() && !timer.isPaused();
+	if( !gTimeTextTexture.loadFromRenderedText( timeText.str().c_str(), textColor, !timeChanging ) )
 	{
 		printf( "Unable to render time texture!\n" );
 	}
 
+	//Render text cache statistics
+	statsText.str( "" );
+	statsText << "Text cache hits " << gTextCache.getHits() << " misses " << gTextCache.getMisses();
+	if( !gCacheStatsTexture.loadFromRenderedText( statsText.str().c_str(), textColor, false ) )
+	{
+		printf( "Unable to render cache statistics texture!\n" );
+	}
+
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
@@ -565,6 +840,7 @@ void loop_handler(void*)
 	gStartPromptTexture.render( ( SCREEN_WIDTH - gStartPromptTexture.getWidth() ) / 2, 0 );
 	gPausePromptTexture.render( ( SCREEN_WIDTH - gPausePromptTexture.getWidth() ) / 2, gStartPromptTexture.getHeight() );
 	gTimeTextTexture.render( ( SCREEN_WIDTH - gTimeTextTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gTimeTextTexture.getHeight() ) / 2 );
+	gCacheStatsTexture.render( ( SCREEN_WIDTH - gCacheStatsTexture.getWidth() ) / 2, SCREEN_HEIGHT - gCacheStatsTexture.getHeight() );
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -1,13 +1,14 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//Using SDL, SDL_image, SDL_ttf, standard IO, strings, string streams, and vectors
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -18,6 +19,9 @@ const int SCREEN_HEIGHT = 480;
 const int SCREEN_FPS = 60;
 const int SCREEN_TICK_PER_FRAME = 1000 / SCREEN_FPS;
 
+//Glyph atlas page dimensions
+const int ATLAS_PAGE_SIZE = 512;
+
 //Texture wrapper class
 class LTexture
 {
@@ -64,6 +68,80 @@ class LTexture
 		int mHeight;
 };
 
+#ifdef _SDL_TTF_H
+//Caches a font's glyphs in texture pages so text can be drawn without rendering new surfaces
+class LGlyphAtlas
+{
+	public:
+		//Initializes variables
+		LGlyphAtlas();
+
+		//Deallocates memory
+		~LGlyphAtlas();
+
+		//Sets the font glyphs are rasterized from, dropping glyphs from the previous one
+		void setFont( TTF_Font* font );
+
+		//Deallocates pages and forgets cached glyphs
+		void free();
+
+		//Renders text at given point, caching glyphs that haven't been seen yet
+		void render( int x, int y, const std::string& text, SDL_Color color );
+
+		//Gets text dimensions
+		int getTextWidth( const std::string& text );
+		int getTextHeight();
+
+		//Gets the number of texture pages in use
+		int getPageCount();
+
+	private:
+		//Where a glyph lives in the pages
+		struct Glyph
+		{
+			bool cached;
+			int page;
+			SDL_Rect clip;
+			int advance;
+		};
+
+		//Gets the glyph for a character, rasterizing it on first use
+		Glyph& getGlyph( unsigned char c );
+
+		//Rasterizes a glyph into the current page, opening a new one if it's full
+		bool addGlyph( Glyph& glyph, Uint16 c );
+
+		//Opens a new page with every pixel cleared
+		bool addPage();
+
+		//The font glyphs come from
+		TTF_Font* mFont;
+
+		//Glyphs for every Latin-1 character
+		Glyph mGlyphs[ 256 ];
+
+		//The texture pages glyphs are packed into
+		std::vector<SDL_Texture*> mPages;
+
+		//Where the next glyph goes in the last page
+		int mPenX;
+		int mPenY;
+		int mShelfHeight;
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+		//Queues a glyph's quad in the given color
+		void queueGlyph( Glyph& glyph, int x, int y, SDL_Color color );
+
+		//Draws the queued quads from a page in one geometry call and empties the queue
+		void flushGlyphs( int page );
+
+		//Four vertices and six indices per queued glyph, kept between draws
+		std::vector<SDL_Vertex> mVertices;
+		std::vector<int> mIndices;
+#endif
+};
+#endif
+
 //The application time based timer
 class LTimer
 {
@@ -114,8 +192,8 @@ SDL_Renderer* gRenderer = NULL;
 //Globally used font
 TTF_Font* gFont = NULL;
 
-//Scene textures
-LTexture gFPSTextTexture;
+//Cached glyphs for the FPS text
+LGlyphAtlas gFPSText;
 
 LTexture::LTexture()
 {
@@ -265,6 +343,303 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+#ifdef _SDL_TTF_H
+LGlyphAtlas::LGlyphAtlas()
+{
+	//Initialize
+	mFont = NULL;
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+	for( int i = 0; i < 256; ++i )
+	{
+		mGlyphs[ i ].cached = false;
+	}
+}
+
+LGlyphAtlas::~LGlyphAtlas()
+{
+	//Deallocate
+	free();
+}
+
+void LGlyphAtlas::setFont( TTF_Font* font )
+{
+	//Glyphs from another font are no use
+	free();
+	mFont = font;
+}
+
+void LGlyphAtlas::free()
+{
+	//Free pages
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		SDL_DestroyTexture( mPages[ i ] );
+	}
+	mPages.clear();
+
+	//Forget glyphs
+	for( int i = 0; i < 256; ++i )
+	{
+		mGlyphs[ i ].cached = false;
+	}
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+}
+
+void LGlyphAtlas::render( int x, int y, const std::string& text, SDL_Color color )
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Queue the glyphs colored by their vertices and draw each run from one page at once
+	int penX = x;
+	int batchPage = -1;
+	for( int i = 0; i < (int)text.size(); ++i )
+	{
+		Glyph& glyph = getGlyph( text[ i ] );
+		if( glyph.clip.w > 0 )
+		{
+			//Glyphs from another page can't share the draw call
+			if( glyph.page != batchPage )
+			{
+				flushGlyphs( batchPage );
+				batchPage = glyph.page;
+			}
+			queueGlyph( glyph, penX, y, color );
+		}
+		penX += glyph.advance;
+	}
+	flushGlyphs( batchPage );
+#else
+	//Cache new glyphs first so every page they land in gets colored
+	for( int i = 0; i < (int)text.size(); ++i )
+	{
+		getGlyph( text[ i ] );
+	}
+
+	//Glyphs are cached white so any color is just a modulation
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		SDL_SetTextureColorMod( mPages[ i ], color.r, color.g, color.b );
+		SDL_SetTextureAlphaMod( mPages[ i ], color.a );
+	}
+
+	//Draw each glyph from its page, consecutive copies from the same texture get batched by the renderer
+	int penX = x;
+	for( int i = 0; i < (int)text.size(); ++i )
+	{
+		Glyph& glyph = getGlyph( text[ i ] );
+		if( glyph.clip.w > 0 )
+		{
+			SDL_Rect renderQuad = { penX, y, glyph.clip.w, glyph.clip.h };
+			SDL_RenderCopy( gRenderer, mPages[ glyph.page ], &glyph.clip, &renderQuad );
+		}
+		penX += glyph.advance;
+	}
+#endif
+}
+
+int LGlyphAtlas::getTextWidth( const std::string& text )
+{
+	//Add up the advances
+	int width = 0;
+	for( int i = 0; i < (int)text.size(); ++i )
+	{
+		width += getGlyph( text[ i ] ).advance;
+	}
+
+	return width;
+}
+
+int LGlyphAtlas::getTextHeight()
+{
+	return mFont != NULL ? TTF_FontHeight( mFont ) : 0;
+}
+
+int LGlyphAtlas::getPageCount()
+{
+	return (int)mPages.size();
+}
+
+LGlyphAtlas::Glyph& LGlyphAtlas::getGlyph( unsigned char c )
+{
+	Glyph& glyph = mGlyphs[ c ];
+	if( !glyph.cached )
+	{
+		//Only try once, a glyph that failed to cache is drawn as nothing
+		glyph.cached = true;
+		glyph.page = 0;
+		glyph.clip.x = 0;
+		glyph.clip.y = 0;
+		glyph.clip.w = 0;
+		glyph.clip.h = 0;
+		glyph.advance = 0;
+		if( mFont != NULL && !addGlyph( glyph, c ) )
+		{
+			printf( "Unable to cache glyph %d!\n", c );
+		}
+	}
+
+	return glyph;
+}
+
+bool LGlyphAtlas::addGlyph( Glyph& glyph, Uint16 c )
+{
+	//Get how far the glyph moves the pen
+	int minX, maxX, minY, maxY;
+	if( TTF_GlyphMetrics( mFont, c, &minX, &maxX, &minY, &maxY, &glyph.advance ) == -1 )
+	{
+		printf( "Unable to get glyph metrics! SDL_ttf Error: %s\n", TTF_GetError() );
+		return false;
+	}
+
+	//Render the glyph in white, it gets colored when drawn
+	SDL_Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+	SDL_Surface* glyphSurface = TTF_RenderGlyph_Blended( mFont, c, white );
+	if( glyphSurface == NULL )
+	{
+		//Blank glyphs like spaces have nothing to render
+		return glyph.advance > 0;
+	}
+
+	bool success = true;
+	if( glyphSurface->w > ATLAS_PAGE_SIZE || glyphSurface->h > ATLAS_PAGE_SIZE )
+	{
+		printf( "Glyph %d doesn't fit in an atlas page!\n", c );
+		success = false;
+	}
+	else
+	{
+		//Start a new shelf when the glyph doesn't fit on this one
+		if( mPenX + glyphSurface->w > ATLAS_PAGE_SIZE )
+		{
+			mPenX = 0;
+			mPenY += mShelfHeight;
+			mShelfHeight = 0;
+		}
+
+		//Start a new page when the glyph doesn't fit below the last shelf
+		if( mPages.empty() || mPenY + glyphSurface->h > ATLAS_PAGE_SIZE )
+		{
+			success = addPage();
+		}
+
+		if( success )
+		{
+			//Upload the glyph into its spot
+			SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( glyphSurface, SDL_PIXELFORMAT_ARGB8888, 0 );
+			if( formattedSurface == NULL )
+			{
+				printf( "Unable to convert glyph surface! SDL Error: %s\n", SDL_GetError() );
+				success = false;
+			}
+			else
+			{
+				SDL_Rect clip = { mPenX, mPenY, formattedSurface->w, formattedSurface->h };
+				if( SDL_UpdateTexture( mPages.back(), &clip, formattedSurface->pixels, formattedSurface->pitch ) != 0 )
+				{
+					printf( "Unable to upload glyph! SDL Error: %s\n", SDL_GetError() );
+					success = false;
+				}
+				else
+				{
+					glyph.page = (int)mPages.size() - 1;
+					glyph.clip = clip;
+
+					//Move the pen past the glyph, leaving a gap so filtering doesn't bleed between glyphs
+					mPenX += clip.w + 1;
+					mShelfHeight = SDL_max( mShelfHeight, clip.h + 1 );
+				}
+
+				SDL_FreeSurface( formattedSurface );
+			}
+		}
+	}
+
+	//Get rid of the glyph surface
+	SDL_FreeSurface( glyphSurface );
+
+	return success;
+}
+
+bool LGlyphAtlas::addPage()
+{
+	SDL_Texture* page = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE );
+	if( page == NULL )
+	{
+		printf( "Unable to create atlas page! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+
+	//New textures hold whatever was in memory, clear them so filtering at glyph edges only picks up transparent pixels
+	std::vector<Uint32> blank( ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 0 );
+	if( SDL_UpdateTexture( page, NULL, &blank[ 0 ], ATLAS_PAGE_SIZE * 4 ) != 0 )
+	{
+		printf( "Unable to clear atlas page! SDL Error: %s\n", SDL_GetError() );
+		SDL_DestroyTexture( page );
+		return false;
+	}
+
+	SDL_SetTextureBlendMode( page, SDL_BLENDMODE_BLEND );
+	mPages.push_back( page );
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+	return true;
+}
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+void LGlyphAtlas::queueGlyph( Glyph& glyph, int x, int y, SDL_Color color )
+{
+	//Texture coordinates of the glyph in its page
+	float u0 = (float)glyph.clip.x / ATLAS_PAGE_SIZE;
+	float v0 = (float)glyph.clip.y / ATLAS_PAGE_SIZE;
+	float u1 = (float)( glyph.clip.x + glyph.clip.w ) / ATLAS_PAGE_SIZE;
+	float v1 = (float)( glyph.clip.y + glyph.clip.h ) / ATLAS_PAGE_SIZE;
+
+	//Corners of the quad
+	float cornerX[ 4 ] = { 0.f, (float)glyph.clip.w, (float)glyph.clip.w, 0.f };
+	float cornerY[ 4 ] = { 0.f, 0.f, (float)glyph.clip.h, (float)glyph.clip.h };
+	float cornerU[ 4 ] = { u0, u1, u1, u0 };
+	float cornerV[ 4 ] = { v0, v0, v1, v1 };
+
+	//Queue the two triangles of the quad
+	int first = mVertices.size();
+	for( int i = 0; i < 4; ++i )
+	{
+		SDL_Vertex vertex;
+		vertex.position.x = x + cornerX[ i ];
+		vertex.position.y = y + cornerY[ i ];
+		vertex.color = color;
+		vertex.tex_coord.x = cornerU[ i ];
+		vertex.tex_coord.y = cornerV[ i ];
+		mVertices.push_back( vertex );
+	}
+
+	mIndices.push_back( first );
+	mIndices.push_back( first + 1 );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first + 3 );
+}
+
+void LGlyphAtlas::flushGlyphs( int page )
+{
+	//Draw every queued glyph at once, the glyphs are white so the vertex colors show through
+	if( !mIndices.empty() )
+	{
+		SDL_RenderGeometry( gRenderer, mPages[ page ], &mVertices[ 0 ], mVertices.size(), &mIndices[ 0 ], mIndices.size() );
+	}
+
+	//Empty the queue but keep its memory
+	mVertices.clear();
+	mIndices.clear();
+}
+#endif
+#endif
+
 LTimer::LTimer()
 {
     //Initialize the variables
@@ -448,14 +823,19 @@ bool loadMedia()
 		printf( "Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError() );
 		success = false;
 	}
+	else
+	{
+		//Cache glyphs from the font
+		gFPSText.setFont( gFont );
+	}
 
 	return success;
 }
 
 void close()
 {
-	//Free loaded images
-	gFPSTextTexture.free();
+	//Free cached glyphs
+	gFPSText.free();
 
 	//Free global font
 	TTF_CloseFont( gFont );
@@ -521,18 +901,13 @@ void loop_handler(void*)
 	timeText.str( "" );
 	timeText << "Average Frames Per Second (With Cap) " << avgFPS; 
 
-	//Render text
-	if( !gFPSTextTexture.loadFromRenderedText( timeText.str().c_str(), textColor ) )
-	{
-		printf( "Unable to render FPS texture!\n" );
-	}
-
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
-	//Render textures
-	gFPSTextTexture.render( ( SCREEN_WIDTH - gFPSTextTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gFPSTextTexture.getHeight() ) / 2 );
+	//Render text from the cached glyphs
+	std::string fpsText = timeText.str();
+	gFPSText.render( ( SCREEN_WIDTH - gFPSText.getTextWidth( fpsText ) ) / 2, ( SCREEN_HEIGHT - gFPSText.getTextHeight() ) / 2, fpsText, textColor );
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -1,11 +1,12 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, and strings
+//Using SDL, SDL_image, standard IO, strings, and vectors
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -14,6 +15,13 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Number and size of the boxes drifting around the screen
+const int TOTAL_CROWD = 10000;
+const int CROWD_BOX_SIZE = 3;
+
+//Cell size of the grid that finds touching boxes
+const int CROWD_CELL_SIZE = 8;
+
 //Texture wrapper class
 class LTexture
 {
@@ -94,6 +102,69 @@ class Dot
 		SDL_Rect mCollider;
 };
 
+//Two boxes that may be touching
+struct CollisionPair
+{
+	int a, b;
+};
+
+//Uniform grid that finds which of many boxes may be touching, its cells are hashed into a table sized to the boxes
+class CollisionGrid
+{
+	public:
+		//Initializes the variables with the width and height of a cell
+		CollisionGrid( int cellSize );
+
+		//Sorts the boxes into cells, the boxes have to outlive the grid's use of them
+		void build( std::vector<SDL_Rect>& boxes );
+
+		//Gets every pair of boxes that share a cell, each pair once
+		void findPairs( std::vector<CollisionPair>& pairs );
+
+		//Gets every box that shares a cell with a box
+		void query( SDL_Rect box, std::vector<int>& hits );
+
+	private:
+		//A box in one of the cells it covers
+		struct CellEntry
+		{
+			int box;
+			int column;
+			int row;
+		};
+
+		//Gets the cells a box covers
+		void getCells( SDL_Rect& box, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow );
+
+		//Gets the cell a coordinate falls in
+		int toCell( int offset );
+
+		//Gets the table bucket a cell is hashed to
+		int getBucket( int column, int row );
+
+		//Cell dimensions
+		int mCellSize;
+
+		//The boxes sorted into cells
+		std::vector<SDL_Rect>* mBoxes;
+
+		//Number of buckets minus one, the bucket count is a power of two
+		int mBucketMask;
+
+		//Where each bucket's entries start in the entry list, with an extra entry for the end
+		std::vector<int> mBucketStart;
+
+		//The cell entries of every bucket, one bucket after another
+		std::vector<CellEntry> mEntries;
+
+		//Where the next entry of each bucket goes while building
+		std::vector<int> mBucketNext;
+
+		//Boxes already reported by a query
+		std::vector<int> mQueryMarks;
+		int mQueryMark;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -106,6 +177,15 @@ void close();
 //Box collision detector
 bool checkCollision( SDL_Rect a, SDL_Rect b );
 
+//Scatters the crowd of boxes
+void createCrowd();
+
+//Moves the crowd of boxes and finds which boxes touch
+void moveCrowd();
+
+//Shows the crowd of boxes, touching ones in red
+void renderCrowd();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -115,6 +195,19 @@ SDL_Renderer* gRenderer = NULL;
 //Scene textures
 LTexture gDotTexture;
 
+//The crowd of boxes, their velocities and which of them touch
+std::vector<SDL_Rect> gCrowd;
+std::vector<SDL_Point> gCrowdVelocities;
+std::vector<bool> gCrowdTouching;
+
+//The grid and the pairs it found this frame
+CollisionGrid gCrowdGrid( CROWD_CELL_SIZE );
+std::vector<CollisionPair> gCrowdPairs;
+
+//The boxes split by whether they touch, kept between frames so drawing doesn't allocate
+std::vector<SDL_Rect> gCrowdApartRects;
+std::vector<SDL_Rect> gCrowdTouchingRects;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -339,6 +432,165 @@ void Dot::render()
 	gDotTexture.render( mPosX, mPosY );
 }
 
+CollisionGrid::CollisionGrid( int cellSize )
+{
+	//Initialize
+	mCellSize = cellSize;
+	mBoxes = NULL;
+	mBucketMask = 0;
+	mQueryMark = 0;
+}
+
+void CollisionGrid::build( std::vector<SDL_Rect>& boxes )
+{
+	mBoxes = &boxes;
+
+	//Two buckets per box, however far apart the boxes are
+	int bucketCount = 1;
+	while( bucketCount < 2 * (int)boxes.size() )
+	{
+		bucketCount *= 2;
+	}
+	mBucketMask = bucketCount - 1;
+
+	//Count the entries of each bucket
+	mBucketStart.assign( bucketCount + 1, 0 );
+	for( int i = 0; i < (int)boxes.size(); ++i )
+	{
+		int firstColumn, firstRow, lastColumn, lastRow;
+		getCells( boxes[ i ], firstColumn, firstRow, lastColumn, lastRow );
+		for( int row = firstRow; row <= lastRow; ++row )
+		{
+			for( int column = firstColumn; column <= lastColumn; ++column )
+			{
+				mBucketStart[ getBucket( column, row ) + 1 ]++;
+			}
+		}
+	}
+
+	//Turn the counts into where each bucket starts
+	for( int bucket = 0; bucket < bucketCount; ++bucket )
+	{
+		mBucketStart[ bucket + 1 ] += mBucketStart[ bucket ];
+	}
+
+	//Put the boxes in the buckets of their cells, each bucket fills from its start
+	mBucketNext.assign( mBucketStart.begin(), mBucketStart.end() - 1 );
+	mEntries.resize( mBucketStart.back() );
+	for( int i = 0; i < (int)boxes.size(); ++i )
+	{
+		int firstColumn, firstRow, lastColumn, lastRow;
+		getCells( boxes[ i ], firstColumn, firstRow, lastColumn, lastRow );
+		for( int row = firstRow; row <= lastRow; ++row )
+		{
+			for( int column = firstColumn; column <= lastColumn; ++column )
+			{
+				CellEntry& entry = mEntries[ mBucketNext[ getBucket( column, row ) ]++ ];
+				entry.box = i;
+				entry.column = column;
+				entry.row = row;
+			}
+		}
+	}
+}
+
+void CollisionGrid::findPairs( std::vector<CollisionPair>& pairs )
+{
+	pairs.clear();
+
+	//Go through the buckets
+	for( int bucket = 0; bucket + 1 < (int)mBucketStart.size(); ++bucket )
+	{
+		for( int i = mBucketStart[ bucket ]; i < mBucketStart[ bucket + 1 ]; ++i )
+		{
+			CellEntry& a = mEntries[ i ];
+			int firstColumnA, firstRowA, lastColumnA, lastRowA;
+			getCells( ( *mBoxes )[ a.box ], firstColumnA, firstRowA, lastColumnA, lastRowA );
+
+			for( int j = i + 1; j < mBucketStart[ bucket + 1 ]; ++j )
+			{
+				//Different cells can hash to the same bucket
+				CellEntry& b = mEntries[ j ];
+				if( b.column != a.column || b.row != a.row )
+				{
+					continue;
+				}
+
+				int firstColumnB, firstRowB, lastColumnB, lastRowB;
+				getCells( ( *mBoxes )[ b.box ], firstColumnB, firstRowB, lastColumnB, lastRowB );
+
+				//Boxes sharing several cells are only reported from the first cell they share
+				if( a.column == SDL_max( firstColumnA, firstColumnB ) && a.row == SDL_max( firstRowA, firstRowB ) )
+				{
+					CollisionPair pair = { a.box, b.box };
+					pairs.push_back( pair );
+				}
+			}
+		}
+	}
+}
+
+void CollisionGrid::query( SDL_Rect box, std::vector<int>& hits )
+{
+	hits.clear();
+	if( mBoxes == NULL || mEntries.empty() )
+	{
+		return;
+	}
+
+	//A new mark so boxes in several cells are only reported once
+	mQueryMarks.resize( mBoxes->size(), 0 );
+	if( ++mQueryMark == 0 )
+	{
+		mQueryMarks.assign( mBoxes->size(), 0 );
+		mQueryMark = 1;
+	}
+
+	//Only look at the cells the box covers
+	int firstColumn, firstRow, lastColumn, lastRow;
+	getCells( box, firstColumn, firstRow, lastColumn, lastRow );
+
+	for( int row = firstRow; row <= lastRow; ++row )
+	{
+		for( int column = firstColumn; column <= lastColumn; ++column )
+		{
+			int bucket = getBucket( column, row );
+			for( int i = mBucketStart[ bucket ]; i < mBucketStart[ bucket + 1 ]; ++i )
+			{
+				//Skip other cells sharing the bucket and boxes already reported
+				CellEntry& entry = mEntries[ i ];
+				int hit = entry.box;
+				if( entry.column == column && entry.row == row && mQueryMarks[ hit ] != mQueryMark )
+				{
+					mQueryMarks[ hit ] = mQueryMark;
+					hits.push_back( hit );
+				}
+			}
+		}
+	}
+}
+
+void CollisionGrid::getCells( SDL_Rect& box, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow )
+{
+	//Boxes cover the cells their inside covers, so an edge on a cell border stays out of the next cell
+	firstColumn = toCell( box.x );
+	firstRow = toCell( box.y );
+	lastColumn = toCell( box.x + SDL_max( box.w, 1 ) - 1 );
+	lastRow = toCell( box.y + SDL_max( box.h, 1 ) - 1 );
+}
+
+int CollisionGrid::toCell( int offset )
+{
+	//Round down so negative coordinates land in negative cells
+	return offset >= 0 ? offset / mCellSize : ( offset - mCellSize + 1 ) / mCellSize;
+}
+
+int CollisionGrid::getBucket( int column, int row )
+{
+	//Mix the cell coordinates so neighboring cells spread over the table
+	return (int)( ( (Uint32)column * 73856093u ) ^ ( (Uint32)row * 19349663u ) ) & mBucketMask;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -477,6 +729,86 @@ bool checkCollision( SDL_Rect a, SDL_Rect b )
     return true;
 }
 
+void createCrowd()
+{
+	//Scatter the boxes with random velocities
+	gCrowd.resize( TOTAL_CROWD );
+	gCrowdVelocities.resize( TOTAL_CROWD );
+	gCrowdTouching.resize( TOTAL_CROWD );
+	for( int i = 0; i < TOTAL_CROWD; ++i )
+	{
+		gCrowd[ i ].x = rand() % ( SCREEN_WIDTH - CROWD_BOX_SIZE );
+		gCrowd[ i ].y = rand() % ( SCREEN_HEIGHT - CROWD_BOX_SIZE );
+		gCrowd[ i ].w = CROWD_BOX_SIZE;
+		gCrowd[ i ].h = CROWD_BOX_SIZE;
+		gCrowdVelocities[ i ].x = rand() % 5 - 2;
+		gCrowdVelocities[ i ].y = rand() % 5 - 2;
+	}
+}
+
+void moveCrowd()
+{
+	for( int i = 0; i < TOTAL_CROWD; ++i )
+	{
+		SDL_Rect& box = gCrowd[ i ];
+		SDL_Point& velocity = gCrowdVelocities[ i ];
+
+		//Move the box and bounce it off the screen edges
+		box.x += velocity.x;
+		if( ( box.x < 0 ) || ( box.x + box.w > SCREEN_WIDTH ) )
+		{
+			velocity.x = -velocity.x;
+			box.x += velocity.x;
+		}
+		box.y += velocity.y;
+		if( ( box.y < 0 ) || ( box.y + box.h > SCREEN_HEIGHT ) )
+		{
+			velocity.y = -velocity.y;
+			box.y += velocity.y;
+		}
+	}
+
+	//Find the pairs that may touch
+	gCrowdGrid.build( gCrowd );
+	gCrowdGrid.findPairs( gCrowdPairs );
+
+	//Mark the boxes that really touch
+	gCrowdTouching.assign( TOTAL_CROWD, false );
+	for( int i = 0; i < (int)gCrowdPairs.size(); ++i )
+	{
+		CollisionPair& pair = gCrowdPairs[ i ];
+		if( checkCollision( gCrowd[ pair.a ], gCrowd[ pair.b ] ) )
+		{
+			gCrowdTouching[ pair.a ] = true;
+			gCrowdTouching[ pair.b ] = true;
+		}
+	}
+}
+
+void renderCrowd()
+{
+	//Split the boxes by whether they touch
+	gCrowdApartRects.clear();
+	gCrowdTouchingRects.clear();
+	for( int i = 0; i < TOTAL_CROWD; ++i )
+	{
+		if( gCrowdTouching[ i ] )
+		{
+			gCrowdTouchingRects.push_back( gCrowd[ i ] );
+		}
+		else
+		{
+			gCrowdApartRects.push_back( gCrowd[ i ] );
+		}
+	}
+
+	//Draw the boxes apart in gray and the boxes that touch in red
+	SDL_SetRenderDrawColor( gRenderer, 0xA0, 0xA0, 0xA0, 0xFF );
+	SDL_RenderFillRects( gRenderer, gCrowdApartRects.data(), gCrowdApartRects.size() );
+	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0x00, 0x00, 0xFF );
+	SDL_RenderFillRects( gRenderer, gCrowdTouchingRects.data(), gCrowdTouchingRects.size() );
+}
+
 //Main loop flag
 bool quit = false;
 
@@ -509,6 +841,9 @@ void loop_handler(void*)
 	//Move the dot and check collision
 	dot.move( wall );
 
+	//Move the crowd and check collision
+	moveCrowd();
+
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
@@ -516,6 +851,9 @@ void loop_handler(void*)
 	//Render wall
 	SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );		
 	SDL_RenderDrawRect( gRenderer, &wall );
+
+	//Render crowd
+	renderCrowd();
 				
 	//Render dot
 	dot.render();
@@ -545,6 +883,9 @@ int main( int argc, char* args[] )
 			wall.y = 40;
 			wall.w = 40;
 			wall.h = 400;
+
+			//Scatter the crowd
+			createCrowd();
 #ifdef _JS
 
                         emscripten_set_main_loop_arg(loop_handler, NULL, -1, 1);
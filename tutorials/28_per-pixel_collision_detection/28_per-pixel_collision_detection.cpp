@@ -15,6 +15,39 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Which pixels of an image are solid, one bit per pixel packed into 64 bit words per row
+class LCollisionMask
+{
+	public:
+		//Initializes variables
+		LCollisionMask();
+
+		//Builds the mask from a surface, pixels that are color keyed or mostly transparent are empty
+		bool createFromSurface( SDL_Surface* surface, Uint8 alphaThreshold = 0x80 );
+
+		//Deallocates the mask
+		void free();
+
+		//Checks if a pixel is solid, pixels outside the mask are empty
+		bool isSolid( int x, int y );
+
+		//Gets 64 pixels of a row starting at a pixel, the first pixel in the lowest bit and pixels past the row empty
+		Uint64 getBits( int x, int y );
+
+		//Gets mask dimensions
+		int getWidth();
+		int getHeight();
+
+	private:
+		//The rows of bits
+		std::vector<Uint64> mBits;
+
+		//Mask dimensions
+		int mWidth;
+		int mHeight;
+		int mWordsPerRow;
+};
+
 //Texture wrapper class
 class LTexture
 {
@@ -52,10 +85,16 @@ class LTexture
 		int getWidth();
 		int getHeight();
 
+		//Gets the solid pixels of the image
+		LCollisionMask& getMask();
+
 	private:
 		//The actual hardware texture
 		SDL_Texture* mTexture;
 
+		//The solid pixels of the image
+		LCollisionMask mMask;
+
 		//Image dimensions
 		int mWidth;
 		int mHeight;
@@ -78,27 +117,18 @@ class Dot
 		//Takes key presses and adjusts the dot's velocity
 		void handleEvent( SDL_Event& e );
 
-		//Moves the dot and checks collision
-		void move( std::vector<SDL_Rect>& otherColliders );
+		//Moves the dot and checks collision against another dot
+		void move( Dot& other );
 
 		//Shows the dot on the screen
 		void render();
 
-		//Gets the collision boxes
-		std::vector<SDL_Rect>& getColliders();
-
     private:
 		//The X and Y offsets of the dot
 		int mPosX, mPosY;
 
 		//The velocity of the dot
 		int mVelX, mVelY;
-		
-		//Dot's collision boxes
-	    std::vector<SDL_Rect> mColliders;
-
-		//Moves the collision boxes relative to the dot's offset
-		void shiftColliders();
 };
 
 //Starts up SDL and creates window
@@ -110,8 +140,8 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
-//Box set collision detector
-bool checkCollision( std::vector<SDL_Rect>& a, std::vector<SDL_Rect>& b );
+//Pixel mask collision detector
+bool checkCollision( LCollisionMask& a, int aX, int aY, LCollisionMask& b, int bX, int bY );
 
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
@@ -122,6 +152,94 @@ SDL_Renderer* gRenderer = NULL;
 //Scene textures
 LTexture gDotTexture;
 
+LCollisionMask::LCollisionMask()
+{
+	//Initialize
+	mWidth = 0;
+	mHeight = 0;
+	mWordsPerRow = 0;
+}
+
+bool LCollisionMask::createFromSurface( SDL_Surface* surface, Uint8 alphaThreshold )
+{
+	//Get rid of preexisting mask
+	free();
+
+	//Convert to 32 bit with alpha, color keyed pixels come out transparent
+	SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( surface, SDL_PIXELFORMAT_ARGB8888, 0 );
+	if( formattedSurface == NULL )
+	{
+		printf( "Unable to convert surface for collision mask! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+
+	mWidth = formattedSurface->w;
+	mHeight = formattedSurface->h;
+	mWordsPerRow = ( mWidth + 63 ) / 64;
+	mBits.assign( mWordsPerRow * mHeight, 0 );
+
+	//Set the bits of the solid pixels
+	SDL_LockSurface( formattedSurface );
+	for( int y = 0; y < mHeight; ++y )
+	{
+		Uint32* pixels = (Uint32*)( (Uint8*)formattedSurface->pixels + y * formattedSurface->pitch );
+		for( int x = 0; x < mWidth; ++x )
+		{
+			if( ( pixels[ x ] >> 24 ) >= alphaThreshold )
+			{
+				mBits[ y * mWordsPerRow + x / 64 ] |= (Uint64)1 << ( x % 64 );
+			}
+		}
+	}
+	SDL_UnlockSurface( formattedSurface );
+
+	SDL_FreeSurface( formattedSurface );
+	return true;
+}
+
+void LCollisionMask::free()
+{
+	mBits.clear();
+	mWidth = 0;
+	mHeight = 0;
+	mWordsPerRow = 0;
+}
+
+bool LCollisionMask::isSolid( int x, int y )
+{
+	if( x < 0 || y < 0 || x >= mWidth || y >= mHeight )
+	{
+		return false;
+	}
+	return ( mBits[ y * mWordsPerRow + x / 64 ] >> ( x % 64 ) ) & 1;
+}
+
+Uint64 LCollisionMask::getBits( int x, int y )
+{
+	//Rows are padded with empty bits, so only the word index needs checking
+	Uint64* row = &mBits[ y * mWordsPerRow ];
+	int word = x / 64;
+	int shift = x % 64;
+
+	//Shift the bits down from the word the pixel is in and the word after it
+	Uint64 bits = row[ word ] >> shift;
+	if( shift != 0 && word + 1 < mWordsPerRow )
+	{
+		bits |= row[ word + 1 ] << ( 64 - shift );
+	}
+	return bits;
+}
+
+int LCollisionMask::getWidth()
+{
+	return mWidth;
+}
+
+int LCollisionMask::getHeight()
+{
+	return mHeight;
+}
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -155,6 +273,9 @@ bool LTexture::loadFromFile( std::string path )
 		//Color key image
 		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
 
+		//Find the solid pixels
+		mMask.createFromSurface( loadedSurface );
+
 		//Create texture from surface pixels
         newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
 		if( newTexture == NULL )
@@ -270,55 +391,20 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+LCollisionMask& LTexture::getMask()
+{
+	return mMask;
+}
+
 Dot::Dot( int x, int y )
 {
     //Initialize the offsets
     mPosX = x;
     mPosY = y;
 
-    //Create the necessary SDL_Rects
-    mColliders.resize( 11 );
-
     //Initialize the velocity
     mVelX = 0;
     mVelY = 0;
-
-    //Initialize the collision boxes' width and height
-    mColliders[ 0 ].w = 6;
-    mColliders[ 0 ].h = 1;
-
-    mColliders[ 1 ].w = 10;
-    mColliders[ 1 ].h = 1;
-
-    mColliders[ 2 ].w = 14;
-    mColliders[ 2 ].h = 1;
-
-    mColliders[ 3 ].w = 16;
-    mColliders[ 3 ].h = 2;
-
-    mColliders[ 4 ].w = 18;
-    mColliders[ 4 ].h = 2;
-
-    mColliders[ 5 ].w = 20;
-    mColliders[ 5 ].h = 6;
-
-    mColliders[ 6 ].w = 18;
-    mColliders[ 6 ].h = 2;
-
-    mColliders[ 7 ].w = 16;
-    mColliders[ 7 ].h = 2;
-
-    mColliders[ 8 ].w = 14;
-    mColliders[ 8 ].h = 1;
-
-    mColliders[ 9 ].w = 10;
-    mColliders[ 9 ].h = 1;
-
-    mColliders[ 10 ].w = 6;
-    mColliders[ 10 ].h = 1;
-
-	//Initialize colliders relative to position
-	shiftColliders();
 }
 
 void Dot::handleEvent( SDL_Event& e )
@@ -349,30 +435,26 @@ void Dot::handleEvent( SDL_Event& e )
     }
 }
 
-void Dot::move( std::vector<SDL_Rect>& otherColliders )
+void Dot::move( Dot& other )
 {
     //Move the dot left or right
     mPosX += mVelX;
-    shiftColliders();
 
     //If the dot collided or went too far to the left or right
-    if( ( mPosX < 0 ) || ( mPosX + DOT_WIDTH > SCREEN_WIDTH ) || checkCollision( mColliders, otherColliders ) )
+    if( ( mPosX < 0 ) || ( mPosX + DOT_WIDTH > SCREEN_WIDTH ) || checkCollision( gDotTexture.getMask(), mPosX, mPosY, gDotTexture.getMask(), other.mPosX, other.mPosY ) )
     {
         //Move back
         mPosX -= mVelX;
-		shiftColliders();
     }
 
     //Move the dot up or down
     mPosY += mVelY;
-	shiftColliders();
 
     //If the dot collided or went too far up or down
-    if( ( mPosY < 0 ) || ( mPosY + DOT_HEIGHT > SCREEN_HEIGHT ) || checkCollision( mColliders, otherColliders ) )
+    if( ( mPosY < 0 ) || ( mPosY + DOT_HEIGHT > SCREEN_HEIGHT ) || checkCollision( gDotTexture.getMask(), mPosX, mPosY, gDotTexture.getMask(), other.mPosX, other.mPosY ) )
     {
         //Move back
         mPosY -= mVelY;
-		shiftColliders();
     }
 }
 
@@ -382,30 +464,6 @@ void Dot::render()
 	gDotTexture.render( mPosX, mPosY );
 }
 
-void Dot::shiftColliders()
-{
-    //The row offset
-    int r = 0;
-
-    //Go through the dot's collision boxes
-    for( int set = 0; set < mColliders.size(); ++set )
-    {
-        //Center the collision box
-        mColliders[ set ].x = mPosX + ( DOT_WIDTH - mColliders[ set ].w ) / 2;
-
-        //Set the collision box at its row offset
-        mColliders[ set ].y = mPosY + r;
-
-        //Move the row offset down the height of the collision box
-        r += mColliders[ set ].h;
-    }
-}
-
-std::vector<SDL_Rect>& Dot::getColliders()
-{
-	return mColliders;
-}
-
 bool init()
 {
 	//Initialization flag
@@ -499,42 +557,43 @@ void close()
 	SDL_Quit();
 }
 
-bool checkCollision( std::vector<SDL_Rect>& a, std::vector<SDL_Rect>& b )
+bool checkCollision( LCollisionMask& a, int aX, int aY, LCollisionMask& b, int bX, int bY )
 {
-    //The sides of the rectangles
-    int leftA, leftB;
-    int rightA, rightB;
-    int topA, topB;
-    int bottomA, bottomB;
+    //The area both masks cover
+    int left = SDL_max( aX, bX );
+    int right = SDL_min( aX + a.getWidth(), bX + b.getWidth() );
+    int top = SDL_max( aY, bY );
+    int bottom = SDL_min( aY + a.getHeight(), bY + b.getHeight() );
+
+    //If the masks don't share any pixels
+    if( left >= right || top >= bottom )
+    {
+        return false;
+    }
 
-    //Go through the A boxes
-    for( int Abox = 0; Abox < a.size(); Abox++ )
+    //Go through the shared rows
+    for( int y = top; y < bottom; ++y )
     {
-        //Calculate the sides of rect A
-        leftA = a[ Abox ].x;
-        rightA = a[ Abox ].x + a[ Abox ].w;
-        topA = a[ Abox ].y;
-        bottomA = a[ Abox ].y + a[ Abox ].h;
-
-        //Go through the B boxes
-        for( int Bbox = 0; Bbox < b.size(); Bbox++ )
+        //Compare 64 pixels at a time
+        for( int x = left; x < right; x += 64 )
         {
-            //Calculate the sides of rect B
-            leftB = b[ Bbox ].x;
-            rightB = b[ Bbox ].x + b[ Bbox ].w;
-            topB = b[ Bbox ].y;
-            bottomB = b[ Bbox ].y + b[ Bbox ].h;
-
-            //If no sides from A are outside of B
-            if( ( ( bottomA <= topB ) || ( topA >= bottomB ) || ( rightA <= leftB ) || ( leftA >= rightB ) ) == false )
+            Uint64 bits = a.getBits( x - aX, y - aY ) & b.getBits( x - bX, y - bY );
+
+            //Ignore pixels past the shared area
+            if( right - x < 64 )
+            {
+                bits &= ( (Uint64)1 << ( right - x ) ) - 1;
+            }
+
+            //If both masks have a solid pixel in the same place
+            if( bits != 0 )
             {
-                //A collision is detected
                 return true;
             }
         }
     }
 
-    //If neither set of collision boxes touched
+    //If no solid pixels touched
     return false;
 }
 
@@ -566,7 +625,7 @@ void loop_handler(void*)
 	}
 
 	//Move the dot and check collision
-	dot.move( otherDot.getColliders() );
+	dot.move( otherDot );
 
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
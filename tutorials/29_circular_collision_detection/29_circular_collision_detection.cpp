@@ -1,15 +1,32 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, vectors, and strings
+//Using SDL, SDL_image, standard IO, standard math, C strings, vectors, sorting, and strings
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
 #include <string>
 #ifdef _JS
 #include <emscripten.h>
 #endif
 
+//SIMD batch collision detectors are built on x86 targets, compiled for their instruction sets and only called when the CPU has them
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define COLLISION_SIMD
+#include <immintrin.h>
+#ifdef __GNUC__
+#define COLLISION_SSE41_TARGET __attribute__(( target( "sse4.1" ) ))
+#define COLLISION_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#else
+#define COLLISION_SSE41_TARGET
+#define COLLISION_AVX2_TARGET
+#endif
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
@@ -67,6 +84,149 @@ class LTexture
 		int mHeight;
 };
 
+//Many circles stored one array per field, so batches of them can be tested at once
+struct CircleBatch
+{
+	std::vector<Sint32> x, y, r;
+};
+
+//Many boxes stored one array per field, so batches of them can be tested at once
+struct BoxBatch
+{
+	std::vector<Sint32> x, y, w, h;
+};
+
+//Instruction sets the batch collision detectors can use
+enum BatchLevel
+{
+	BATCH_SCALAR,
+	BATCH_SSE41,
+	BATCH_AVX2
+};
+
+//The shapes the collision tree holds
+enum ColliderShape
+{
+	COLLIDER_BOX,
+	COLLIDER_CIRCLE
+};
+
+//Two colliders in the collision tree that touch
+struct ColliderPair
+{
+	int a, b;
+};
+
+//Dynamic bounding volume tree of boxes and circles
+class AABBTree
+{
+	public:
+		//How far the stored boxes reach past their shapes, so small moves leave the tree alone
+		static const int FAT_MARGIN = 8;
+
+		//Initializes the variables
+		AABBTree();
+
+		//Adds a box or a circle and returns its collider id
+		int insert( SDL_Rect& box );
+		int insert( Circle& circle );
+
+		//Removes a collider
+		void remove( int collider );
+
+		//Moves a collider and returns true if it left its stored box and was reinserted
+		bool move( int collider, SDL_Rect& box );
+		bool move( int collider, Circle& circle );
+
+		//Gets the colliders whose stored boxes overlap a box
+		void query( SDL_Rect box, std::vector<int>& hits );
+
+		//Gets the first collider on the line from one point to another and how far along it is hit, -1 if none
+		int rayCast( int x1, int y1, int x2, int y2, double& fraction );
+
+		//Gets every pair of colliders that touch, each pair once
+		void findPairs( std::vector<ColliderPair>& pairs );
+
+		//Checks if a collider touches a circle
+		bool touches( int collider, Circle& circle );
+
+		//Gets height of the tree
+		int getHeight();
+
+	private:
+		//A leaf holding a collider or a branch holding the box around its two children
+		struct Node
+		{
+			//Stored box
+			SDL_Rect box;
+
+			//Parent node, the next free node when the node is free
+			int parent;
+
+			//Child nodes, -1 for leaves
+			int left, right;
+
+			//Height from the leaves, -1 when the node is free
+			int height;
+
+			//The leaf's collider
+			ColliderShape shape;
+			SDL_Rect shapeBox;
+			Circle circle;
+		};
+
+		//Gets a node from the free list or grows the pool
+		int allocateNode();
+
+		//Puts a node on the free list
+		void freeNode( int node );
+
+		//Adds a leaf next to the sibling that grows the tree least
+		void insertLeaf( int leaf );
+
+		//Takes a leaf out of the tree
+		void removeLeaf( int leaf );
+
+		//Rebalances and refits nodes from a node up to the root
+		void refit( int node );
+
+		//Rotates the taller child of an unbalanced node up and returns the node now in its place
+		int balance( int node );
+
+		//Checks if two colliders touch
+		bool touches( int a, int b );
+
+		//Gets the box around a circle
+		static SDL_Rect getBox( Circle& circle );
+
+		//Gets a box grown by the fat margin
+		static SDL_Rect fatten( SDL_Rect& box );
+
+		//Gets the box around two boxes
+		static SDL_Rect combine( SDL_Rect& a, SDL_Rect& b );
+
+		//Gets the perimeter of a box, what the tree tries to keep small
+		static int perimeter( SDL_Rect& box );
+
+		//Checks if a box is inside another
+		static bool contains( SDL_Rect& outer, SDL_Rect& inner );
+
+		//Checks if two boxes overlap or touch
+		static bool overlaps( SDL_Rect& a, SDL_Rect& b );
+
+		//Gets how far along a line it enters a box or a circle
+		static bool rayHitsBox( double x1, double y1, double dx, double dy, SDL_Rect& box, double& fraction );
+		static bool rayHitsCircle( double x1, double y1, double dx, double dy, Circle& circle, double& fraction );
+
+		//The node pool, the root and the first free node
+		std::vector<Node> mNodes;
+		int mRoot;
+		int mFreeList;
+
+		//Nodes left to visit by queries
+		std::vector<int> mStack;
+};
+
 //The dot that will move around on the screen
 class Dot
 {
@@ -84,8 +244,8 @@ class Dot
 		//Takes key presses and adjusts the dot's velocity
 		void handleEvent( SDL_Event& e );
 
-		//Moves the dot and checks collision
-		void move( SDL_Rect& square, Circle& circle );
+		//Moves the dot and checks collision against the collision tree
+		void move();
 
 		//Shows the dot on the screen
 		void render();
@@ -103,8 +263,14 @@ class Dot
 		//Dot's collision circle
 		Circle mCollider;
 
+		//Dot's id in the collision tree
+		int mColliderId;
+
 		//Moves the collision circle relative to the dot's offset
 		void shiftColliders();
+
+		//Checks the collision circle against everything else in the collision tree
+		bool checkColliders();
 };
 
 //Starts up SDL and creates window
@@ -122,8 +288,36 @@ bool checkCollision( Circle& a, Circle& b );
 //Circle/Box collision detector
 bool checkCollision( Circle& a, SDL_Rect& b );
 
+//Box/Box collision detector
+bool checkCollision( SDL_Rect& a, SDL_Rect& b );
+
 //Calculates distance squared between two points
-double distanceSquared( int x1, int y1, int x2, int y2 );
+int distanceSquared( int x1, int y1, int x2, int y2 );
+
+//Batch collision detectors, set bit i of hits when shape i of the batch touches the shape
+//Coordinates stay within +-16384 so squared distances fit in 32 bits
+void checkCollisions( Circle& a, CircleBatch& b, Uint32* hits );
+void checkCollisions( Circle& a, BoxBatch& b, Uint32* hits );
+void checkCollisions( SDL_Rect& a, BoxBatch& b, Uint32* hits );
+
+//Batch collision detectors for one instruction set, they test shapes from first on, which is a multiple of 32
+void checkCirclesScalar( Circle& a, CircleBatch& b, int first, Uint32* hits );
+void checkCircleBoxesScalar( Circle& a, BoxBatch& b, int first, Uint32* hits );
+void checkBoxesScalar( SDL_Rect& a, BoxBatch& b, int first, Uint32* hits );
+#ifdef COLLISION_SIMD
+COLLISION_SSE41_TARGET int checkCirclesSSE41( Circle& a, CircleBatch& b, Uint32* hits );
+COLLISION_SSE41_TARGET int checkCircleBoxesSSE41( Circle& a, BoxBatch& b, Uint32* hits );
+COLLISION_SSE41_TARGET int checkBoxesSSE41( SDL_Rect& a, BoxBatch& b, Uint32* hits );
+COLLISION_AVX2_TARGET int checkCirclesAVX2( Circle& a, CircleBatch& b, Uint32* hits );
+COLLISION_AVX2_TARGET int checkCircleBoxesAVX2( Circle& a, BoxBatch& b, Uint32* hits );
+COLLISION_AVX2_TARGET int checkBoxesAVX2( SDL_Rect& a, BoxBatch& b, Uint32* hits );
+#endif
+
+//Picks the best instruction set the CPU supports for the batch collision detectors
+BatchLevel pickBatchLevel();
+
+//Checks the batch collision detectors of every instruction set against the single shape ones on random shapes
+int fuzzCollisions();
 
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
@@ -134,6 +328,12 @@ SDL_Renderer* gRenderer = NULL;
 //Scene textures
 LTexture gDotTexture;
 
+//Every collider in the scene
+AABBTree gColliders;
+
+//Instruction set the batch collision detectors use
+BatchLevel gBatchLevel = pickBatchLevel();
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -297,6 +497,9 @@ Dot::Dot( int x, int y )
 
 	//Move collider relative to the circle
 	shiftColliders();
+
+	//Add the dot to the collision tree
+	mColliderId = gColliders.insert( mCollider );
 }
 
 void Dot::handleEvent( SDL_Event& e )
@@ -327,14 +530,14 @@ void Dot::handleEvent( SDL_Event& e )
     }
 }
 
-void Dot::move( SDL_Rect& square, Circle& circle )
+void Dot::move()
 {
     //Move the dot left or right
     mPosX += mVelX;
 	shiftColliders();
 
     //If the dot collided or went too far to the left or right
-	if( ( mPosX - mCollider.r < 0 ) || ( mPosX + mCollider.r > SCREEN_WIDTH ) || checkCollision( mCollider, square ) || checkCollision( mCollider, circle ) )
+	if( ( mPosX - mCollider.r < 0 ) || ( mPosX + mCollider.r > SCREEN_WIDTH ) || checkColliders() )
     {
         //Move back
         mPosX -= mVelX;
@@ -346,12 +549,15 @@ void Dot::move( SDL_Rect& square, Circle& circle )
 	shiftColliders();
 
     //If the dot collided or went too far up or down
-    if( ( mPosY - mCollider.r < 0 ) || ( mPosY + mCollider.r > SCREEN_HEIGHT ) || checkCollision( mCollider, square ) || checkCollision( mCollider, circle ) )
+    if( ( mPosY - mCollider.r < 0 ) || ( mPosY + mCollider.r > SCREEN_HEIGHT ) || checkColliders() )
     {
         //Move back
         mPosY -= mVelY;
 		shiftColliders();
     }
+
+	//Let the collision tree know where the dot is now
+	gColliders.move( mColliderId, mCollider );
 }
 
 void Dot::render()
@@ -372,6 +578,654 @@ void Dot::shiftColliders()
 	mCollider.y = mPosY;
 }
 
+bool Dot::checkColliders()
+{
+	//Get the colliders near the dot
+	std::vector<int> hits;
+	SDL_Rect box = { mCollider.x - mCollider.r, mCollider.y - mCollider.r, mCollider.r * 2, mCollider.r * 2 };
+	gColliders.query( box, hits );
+
+	//Check the ones that aren't the dot
+	for( int i = 0; i < (int)hits.size(); ++i )
+	{
+		if( hits[ i ] != mColliderId && gColliders.touches( hits[ i ], mCollider ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+AABBTree::AABBTree()
+{
+	//Initialize
+	mRoot = -1;
+	mFreeList = -1;
+}
+
+int AABBTree::insert( SDL_Rect& box )
+{
+	//Make a leaf for the box
+	int leaf = allocateNode();
+	mNodes[ leaf ].shape = COLLIDER_BOX;
+	mNodes[ leaf ].shapeBox = box;
+	mNodes[ leaf ].box = fatten( box );
+	insertLeaf( leaf );
+	return leaf;
+}
+
+int AABBTree::insert( Circle& circle )
+{
+	//Make a leaf for the circle
+	int leaf = allocateNode();
+	mNodes[ leaf ].shape = COLLIDER_CIRCLE;
+	mNodes[ leaf ].circle = circle;
+	mNodes[ leaf ].shapeBox = getBox( circle );
+	mNodes[ leaf ].box = fatten( mNodes[ leaf ].shapeBox );
+	insertLeaf( leaf );
+	return leaf;
+}
+
+void AABBTree::remove( int collider )
+{
+	removeLeaf( collider );
+	freeNode( collider );
+}
+
+bool AABBTree::move( int collider, SDL_Rect& box )
+{
+	Node& leaf = mNodes[ collider ];
+	leaf.shapeBox = box;
+
+	//Small moves stay inside the stored box
+	if( contains( leaf.box, box ) )
+	{
+		return false;
+	}
+
+	//Reinsert with a new stored box
+	removeLeaf( collider );
+	mNodes[ collider ].box = fatten( box );
+	insertLeaf( collider );
+	return true;
+}
+
+bool AABBTree::move( int collider, Circle& circle )
+{
+	mNodes[ collider ].circle = circle;
+	SDL_Rect box = getBox( circle );
+	return move( collider, box );
+}
+
+void AABBTree::query( SDL_Rect box, std::vector<int>& hits )
+{
+	hits.clear();
+
+	//Go down every branch the box overlaps
+	mStack.clear();
+	mStack.push_back( mRoot );
+	while( !mStack.empty() )
+	{
+		int node = mStack.back();
+		mStack.pop_back();
+		if( node == -1 || !overlaps( mNodes[ node ].box, box ) )
+		{
+			continue;
+		}
+
+		if( mNodes[ node ].left == -1 )
+		{
+			hits.push_back( node );
+		}
+		else
+		{
+			mStack.push_back( mNodes[ node ].left );
+			mStack.push_back( mNodes[ node ].right );
+		}
+	}
+}
+
+int AABBTree::rayCast( int x1, int y1, int x2, int y2, double& fraction )
+{
+	int hit = -1;
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	fraction = 1.0;
+
+	//Go down every branch the line enters before the nearest hit so far
+	mStack.clear();
+	mStack.push_back( mRoot );
+	while( !mStack.empty() )
+	{
+		int node = mStack.back();
+		mStack.pop_back();
+
+		double entry;
+		if( node == -1 || !rayHitsBox( x1, y1, dx, dy, mNodes[ node ].box, entry ) || entry > fraction )
+		{
+			continue;
+		}
+
+		if( mNodes[ node ].left == -1 )
+		{
+			//Test the collider itself
+			bool hitShape;
+			if( mNodes[ node ].shape == COLLIDER_BOX )
+			{
+				hitShape = rayHitsBox( x1, y1, dx, dy, mNodes[ node ].shapeBox, entry );
+			}
+			else
+			{
+				hitShape = rayHitsCircle( x1, y1, dx, dy, mNodes[ node ].circle, entry );
+			}
+
+			if( hitShape && entry <= fraction )
+			{
+				fraction = entry;
+				hit = node;
+			}
+		}
+		else
+		{
+			mStack.push_back( mNodes[ node ].left );
+			mStack.push_back( mNodes[ node ].right );
+		}
+	}
+
+	return hit;
+}
+
+void AABBTree::findPairs( std::vector<ColliderPair>& pairs )
+{
+	pairs.clear();
+
+	//Query the tree with every leaf and test what it finds in batches
+	std::vector<int> hits, circleIds, boxIds;
+	std::vector<Uint32> touching;
+	CircleBatch circles;
+	BoxBatch boxes;
+	for( int leaf = 0; leaf < (int)mNodes.size(); ++leaf )
+	{
+		if( mNodes[ leaf ].height != 0 )
+		{
+			continue;
+		}
+		Node& node = mNodes[ leaf ];
+		query( node.box, hits );
+
+		//Circle and box pairs are tested from the circle, other pairs from the lower id, so each pair is tested once
+		circleIds.clear();
+		boxIds.clear();
+		circles.x.clear();
+		circles.y.clear();
+		circles.r.clear();
+		boxes.x.clear();
+		boxes.y.clear();
+		boxes.w.clear();
+		boxes.h.clear();
+		for( int i = 0; i < (int)hits.size(); ++i )
+		{
+			Node& other = mNodes[ hits[ i ] ];
+			if( other.shape == COLLIDER_CIRCLE && node.shape == COLLIDER_CIRCLE && hits[ i ] > leaf )
+			{
+				circleIds.push_back( hits[ i ] );
+				circles.x.push_back( other.circle.x );
+				circles.y.push_back( other.circle.y );
+				circles.r.push_back( other.circle.r );
+			}
+			else if( other.shape == COLLIDER_BOX && ( node.shape == COLLIDER_CIRCLE || hits[ i ] > leaf ) )
+			{
+				boxIds.push_back( hits[ i ] );
+				boxes.x.push_back( other.shapeBox.x );
+				boxes.y.push_back( other.shapeBox.y );
+				boxes.w.push_back( other.shapeBox.w );
+				boxes.h.push_back( other.shapeBox.h );
+			}
+		}
+
+		//Test the circles
+		touching.resize( hits.size() / 32 + 1 );
+		if( !circleIds.empty() )
+		{
+			checkCollisions( node.circle, circles, &touching[ 0 ] );
+			for( int i = 0; i < (int)circleIds.size(); ++i )
+			{
+				if( ( touching[ i / 32 ] >> ( i % 32 ) ) & 1 )
+				{
+					ColliderPair pair = { leaf, circleIds[ i ] };
+					pairs.push_back( pair );
+				}
+			}
+		}
+
+		//Test the boxes
+		if( !boxIds.empty() )
+		{
+			if( node.shape == COLLIDER_CIRCLE )
+			{
+				checkCollisions( node.circle, boxes, &touching[ 0 ] );
+			}
+			else
+			{
+				checkCollisions( node.shapeBox, boxes, &touching[ 0 ] );
+			}
+			for( int i = 0; i < (int)boxIds.size(); ++i )
+			{
+				if( ( touching[ i / 32 ] >> ( i % 32 ) ) & 1 )
+				{
+					ColliderPair pair = { leaf, boxIds[ i ] };
+					pairs.push_back( pair );
+				}
+			}
+		}
+	}
+}
+
+bool AABBTree::touches( int collider, Circle& circle )
+{
+	Node& leaf = mNodes[ collider ];
+	if( leaf.shape == COLLIDER_BOX )
+	{
+		return checkCollision( circle, leaf.shapeBox );
+	}
+	return checkCollision( circle, leaf.circle );
+}
+
+int AABBTree::getHeight()
+{
+	return mRoot == -1 ? 0 : mNodes[ mRoot ].height;
+}
+
+int AABBTree::allocateNode()
+{
+	//Grow the pool if there are no free nodes
+	int node = mFreeList;
+	if( node == -1 )
+	{
+		node = mNodes.size();
+		mNodes.push_back( Node() );
+	}
+	else
+	{
+		mFreeList = mNodes[ node ].parent;
+	}
+
+	//Initialize as a lone leaf
+	mNodes[ node ].parent = -1;
+	mNodes[ node ].left = -1;
+	mNodes[ node ].right = -1;
+	mNodes[ node ].height = 0;
+	return node;
+}
+
+void AABBTree::freeNode( int node )
+{
+	mNodes[ node ].parent = mFreeList;
+	mNodes[ node ].height = -1;
+	mFreeList = node;
+}
+
+void AABBTree::insertLeaf( int leaf )
+{
+	//The first leaf is the root
+	if( mRoot == -1 )
+	{
+		mRoot = leaf;
+		mNodes[ leaf ].parent = -1;
+		return;
+	}
+
+	//Go down the tree to the sibling where the new leaf adds the least perimeter
+	SDL_Rect leafBox = mNodes[ leaf ].box;
+	int sibling = mRoot;
+	while( mNodes[ sibling ].left != -1 )
+	{
+		Node& node = mNodes[ sibling ];
+		SDL_Rect combined = combine( node.box, leafBox );
+
+		//Cost of pairing the leaf with this node
+		int cost = 2 * perimeter( combined );
+
+		//Cost every child pays for the node growing
+		int inheritedCost = 2 * ( perimeter( combined ) - perimeter( node.box ) );
+
+		//Cost of going down each child
+		int childCosts[ 2 ];
+		int children[ 2 ] = { node.left, node.right };
+		for( int i = 0; i < 2; ++i )
+		{
+			Node& child = mNodes[ children[ i ] ];
+			SDL_Rect childCombined = combine( child.box, leafBox );
+			childCosts[ i ] = perimeter( childCombined ) + inheritedCost;
+			if( child.left != -1 )
+			{
+				childCosts[ i ] -= perimeter( child.box );
+			}
+		}
+
+		//Stop when pairing here is cheapest
+		if( cost < childCosts[ 0 ] && cost < childCosts[ 1 ] )
+		{
+			break;
+		}
+		sibling = childCosts[ 0 ] < childCosts[ 1 ] ? children[ 0 ] : children[ 1 ];
+	}
+
+	//Make a branch holding the sibling and the leaf
+	int oldParent = mNodes[ sibling ].parent;
+	int branch = allocateNode();
+	mNodes[ branch ].parent = oldParent;
+	mNodes[ branch ].box = combine( mNodes[ sibling ].box, leafBox );
+	mNodes[ branch ].height = mNodes[ sibling ].height + 1;
+	mNodes[ branch ].left = sibling;
+	mNodes[ branch ].right = leaf;
+	mNodes[ sibling ].parent = branch;
+	mNodes[ leaf ].parent = branch;
+
+	//Put the branch where the sibling was
+	if( oldParent == -1 )
+	{
+		mRoot = branch;
+	}
+	else if( mNodes[ oldParent ].left == sibling )
+	{
+		mNodes[ oldParent ].left = branch;
+	}
+	else
+	{
+		mNodes[ oldParent ].right = branch;
+	}
+
+	//Fix the boxes above
+	refit( oldParent );
+}
+
+void AABBTree::removeLeaf( int leaf )
+{
+	//The root leaf leaves an empty tree
+	if( leaf == mRoot )
+	{
+		mRoot = -1;
+		return;
+	}
+
+	//The sibling takes the parent's place
+	int parent = mNodes[ leaf ].parent;
+	int grandParent = mNodes[ parent ].parent;
+	int sibling = mNodes[ parent ].left == leaf ? mNodes[ parent ].right : mNodes[ parent ].left;
+	mNodes[ sibling ].parent = grandParent;
+	freeNode( parent );
+
+	if( grandParent == -1 )
+	{
+		mRoot = sibling;
+		return;
+	}
+
+	if( mNodes[ grandParent ].left == parent )
+	{
+		mNodes[ grandParent ].left = sibling;
+	}
+	else
+	{
+		mNodes[ grandParent ].right = sibling;
+	}
+
+	//Fix the boxes above
+	refit( grandParent );
+}
+
+void AABBTree::refit( int node )
+{
+	while( node != -1 )
+	{
+		//Keep the tree balanced
+		node = balance( node );
+
+		//Fit around the children
+		Node& branch = mNodes[ node ];
+		branch.height = 1 + SDL_max( mNodes[ branch.left ].height, mNodes[ branch.right ].height );
+		branch.box = combine( mNodes[ branch.left ].box, mNodes[ branch.right ].box );
+
+		node = branch.parent;
+	}
+}
+
+int AABBTree::balance( int a )
+{
+	Node& nodeA = mNodes[ a ];
+	if( nodeA.left == -1 || nodeA.height < 2 )
+	{
+		return a;
+	}
+
+	int b = nodeA.left;
+	int c = nodeA.right;
+	Node& nodeB = mNodes[ b ];
+	Node& nodeC = mNodes[ c ];
+	int difference = nodeC.height - nodeB.height;
+
+	//Rotate the right child up
+	if( difference > 1 )
+	{
+		int f = nodeC.left;
+		int g = nodeC.right;
+		Node& nodeF = mNodes[ f ];
+		Node& nodeG = mNodes[ g ];
+
+		//C takes A's place and A becomes C's left child
+		nodeC.left = a;
+		nodeC.parent = nodeA.parent;
+		nodeA.parent = c;
+		if( nodeC.parent == -1 )
+		{
+			mRoot = c;
+		}
+		else if( mNodes[ nodeC.parent ].left == a )
+		{
+			mNodes[ nodeC.parent ].left = c;
+		}
+		else
+		{
+			mNodes[ nodeC.parent ].right = c;
+		}
+
+		//The taller grandchild stays with C, the shorter one moves to A
+		if( nodeF.height > nodeG.height )
+		{
+			nodeC.right = f;
+			nodeA.right = g;
+			nodeG.parent = a;
+			nodeA.box = combine( nodeB.box, nodeG.box );
+			nodeC.box = combine( nodeA.box, nodeF.box );
+			nodeA.height = 1 + SDL_max( nodeB.height, nodeG.height );
+			nodeC.height = 1 + SDL_max( nodeA.height, nodeF.height );
+		}
+		else
+		{
+			nodeC.right = g;
+			nodeA.right = f;
+			nodeF.parent = a;
+			nodeA.box = combine( nodeB.box, nodeF.box );
+			nodeC.box = combine( nodeA.box, nodeG.box );
+			nodeA.height = 1 + SDL_max( nodeB.height, nodeF.height );
+			nodeC.height = 1 + SDL_max( nodeA.height, nodeG.height );
+		}
+
+		return c;
+	}
+
+	//Rotate the left child up
+	if( difference < -1 )
+	{
+		int d = nodeB.left;
+		int e = nodeB.right;
+		Node& nodeD = mNodes[ d ];
+		Node& nodeE = mNodes[ e ];
+
+		//B takes A's place and A becomes B's left child
+		nodeB.left = a;
+		nodeB.parent = nodeA.parent;
+		nodeA.parent = b;
+		if( nodeB.parent == -1 )
+		{
+			mRoot = b;
+		}
+		else if( mNodes[ nodeB.parent ].left == a )
+		{
+			mNodes[ nodeB.parent ].left = b;
+		}
+		else
+		{
+			mNodes[ nodeB.parent ].right = b;
+		}
+
+		//The taller grandchild stays with B, the shorter one moves to A
+		if( nodeD.height > nodeE.height )
+		{
+			nodeB.right = d;
+			nodeA.left = e;
+			nodeE.parent = a;
+			nodeA.box = combine( nodeC.box, nodeE.box );
+			nodeB.box = combine( nodeA.box, nodeD.box );
+			nodeA.height = 1 + SDL_max( nodeC.height, nodeE.height );
+			nodeB.height = 1 + SDL_max( nodeA.height, nodeD.height );
+		}
+		else
+		{
+			nodeB.right = e;
+			nodeA.left = d;
+			nodeD.parent = a;
+			nodeA.box = combine( nodeC.box, nodeD.box );
+			nodeB.box = combine( nodeA.box, nodeE.box );
+			nodeA.height = 1 + SDL_max( nodeC.height, nodeD.height );
+			nodeB.height = 1 + SDL_max( nodeA.height, nodeE.height );
+		}
+
+		return b;
+	}
+
+	return a;
+}
+
+bool AABBTree::touches( int a, int b )
+{
+	Node& leafA = mNodes[ a ];
+	Node& leafB = mNodes[ b ];
+	if( leafA.shape == COLLIDER_CIRCLE )
+	{
+		return touches( b, leafA.circle );
+	}
+	if( leafB.shape == COLLIDER_CIRCLE )
+	{
+		return touches( a, leafB.circle );
+	}
+	return checkCollision( leafA.shapeBox, leafB.shapeBox );
+}
+
+SDL_Rect AABBTree::getBox( Circle& circle )
+{
+	SDL_Rect box = { circle.x - circle.r, circle.y - circle.r, circle.r * 2, circle.r * 2 };
+	return box;
+}
+
+SDL_Rect AABBTree::fatten( SDL_Rect& box )
+{
+	SDL_Rect fat = { box.x - FAT_MARGIN, box.y - FAT_MARGIN, box.w + FAT_MARGIN * 2, box.h + FAT_MARGIN * 2 };
+	return fat;
+}
+
+SDL_Rect AABBTree::combine( SDL_Rect& a, SDL_Rect& b )
+{
+	SDL_Rect box;
+	box.x = SDL_min( a.x, b.x );
+	box.y = SDL_min( a.y, b.y );
+	box.w = SDL_max( a.x + a.w, b.x + b.w ) - box.x;
+	box.h = SDL_max( a.y + a.h, b.y + b.h ) - box.y;
+	return box;
+}
+
+int AABBTree::perimeter( SDL_Rect& box )
+{
+	return 2 * ( box.w + box.h );
+}
+
+bool AABBTree::contains( SDL_Rect& outer, SDL_Rect& inner )
+{
+	return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.w <= outer.x + outer.w && inner.y + inner.h <= outer.y + outer.h;
+}
+
+bool AABBTree::overlaps( SDL_Rect& a, SDL_Rect& b )
+{
+	return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+bool AABBTree::rayHitsBox( double x1, double y1, double dx, double dy, SDL_Rect& box, double& fraction )
+{
+	//Clip the line against the box one axis at a time
+	double enter = 0.0;
+	double exit = 1.0;
+	double starts[ 2 ] = { x1, y1 };
+	double deltas[ 2 ] = { dx, dy };
+	double lows[ 2 ] = { (double)box.x, (double)box.y };
+	double highs[ 2 ] = { (double)( box.x + box.w ), (double)( box.y + box.h ) };
+	for( int axis = 0; axis < 2; ++axis )
+	{
+		//A line parallel to the slab misses it if it starts outside
+		if( deltas[ axis ] == 0.0 )
+		{
+			if( starts[ axis ] < lows[ axis ] || starts[ axis ] > highs[ axis ] )
+			{
+				return false;
+			}
+			continue;
+		}
+
+		double slabEnter = ( lows[ axis ] - starts[ axis ] ) / deltas[ axis ];
+		double slabExit = ( highs[ axis ] - starts[ axis ] ) / deltas[ axis ];
+		if( slabEnter > slabExit )
+		{
+			std::swap( slabEnter, slabExit );
+		}
+		enter = SDL_max( enter, slabEnter );
+		exit = SDL_min( exit, slabExit );
+		if( enter > exit )
+		{
+			return false;
+		}
+	}
+
+	fraction = enter;
+	return true;
+}
+
+bool AABBTree::rayHitsCircle( double x1, double y1, double dx, double dy, Circle& circle, double& fraction )
+{
+	//Solve for where the line is a radius from the center
+	double ox = x1 - circle.x;
+	double oy = y1 - circle.y;
+	double c = ox * ox + oy * oy - (double)circle.r * circle.r;
+
+	//Lines starting inside hit right away
+	if( c <= 0.0 )
+	{
+		fraction = 0.0;
+		return true;
+	}
+
+	double a = dx * dx + dy * dy;
+	double b = ox * dx + oy * dy;
+	double discriminant = b * b - a * c;
+	if( a == 0.0 || b >= 0.0 || discriminant < 0.0 )
+	{
+		return false;
+	}
+
+	fraction = ( -b - sqrt( discriminant ) ) / a;
+	return fraction <= 1.0;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -526,13 +1380,421 @@ bool checkCollision( Circle& a, SDL_Rect& b )
     return false;
 }
 
-double distanceSquared( int x1, int y1, int x2, int y2 )
+bool checkCollision( SDL_Rect& a, SDL_Rect& b )
+{
+    //If any of the sides from A are outside of B
+    if( a.y + a.h <= b.y || a.y >= b.y + b.h || a.x + a.w <= b.x || a.x >= b.x + b.w )
+    {
+        return false;
+    }
+
+    //If none of the sides from A are outside B
+    return true;
+}
+
+int distanceSquared( int x1, int y1, int x2, int y2 )
 {
 	int deltaX = x2 - x1;
 	int deltaY = y2 - y1;
 	return deltaX*deltaX + deltaY*deltaY;
 }
 
+void checkCollisions( Circle& a, CircleBatch& b, Uint32* hits )
+{
+	//Let the widest instruction set take whole words of shapes and finish the rest one at a time
+	int first = 0;
+#ifdef COLLISION_SIMD
+	if( gBatchLevel == BATCH_AVX2 )
+	{
+		first = checkCirclesAVX2( a, b, hits );
+	}
+	else if( gBatchLevel == BATCH_SSE41 )
+	{
+		first = checkCirclesSSE41( a, b, hits );
+	}
+#endif
+	checkCirclesScalar( a, b, first, hits );
+}
+
+void checkCollisions( Circle& a, BoxBatch& b, Uint32* hits )
+{
+	int first = 0;
+#ifdef COLLISION_SIMD
+	if( gBatchLevel == BATCH_AVX2 )
+	{
+		first = checkCircleBoxesAVX2( a, b, hits );
+	}
+	else if( gBatchLevel == BATCH_SSE41 )
+	{
+		first = checkCircleBoxesSSE41( a, b, hits );
+	}
+#endif
+	checkCircleBoxesScalar( a, b, first, hits );
+}
+
+void checkCollisions( SDL_Rect& a, BoxBatch& b, Uint32* hits )
+{
+	int first = 0;
+#ifdef COLLISION_SIMD
+	if( gBatchLevel == BATCH_AVX2 )
+	{
+		first = checkBoxesAVX2( a, b, hits );
+	}
+	else if( gBatchLevel == BATCH_SSE41 )
+	{
+		first = checkBoxesSSE41( a, b, hits );
+	}
+#endif
+	checkBoxesScalar( a, b, first, hits );
+}
+
+void checkCirclesScalar( Circle& a, CircleBatch& b, int first, Uint32* hits )
+{
+	int count = b.x.size();
+	for( int i = first; i < count; ++i )
+	{
+		//Start each word of hits empty
+		if( i % 32 == 0 )
+		{
+			hits[ i / 32 ] = 0;
+		}
+
+		//If the distance between the centers is less than the sum of the radii
+		int totalRadius = a.r + b.r[ i ];
+		if( distanceSquared( a.x, a.y, b.x[ i ], b.y[ i ] ) < totalRadius * totalRadius )
+		{
+			hits[ i / 32 ] |= 1u << ( i % 32 );
+		}
+	}
+}
+
+void checkCircleBoxesScalar( Circle& a, BoxBatch& b, int first, Uint32* hits )
+{
+	int count = b.x.size();
+	for( int i = first; i < count; ++i )
+	{
+		if( i % 32 == 0 )
+		{
+			hits[ i / 32 ] = 0;
+		}
+
+		//Closest point on the box
+		int cX = SDL_min( SDL_max( a.x, b.x[ i ] ), b.x[ i ] + b.w[ i ] );
+		int cY = SDL_min( SDL_max( a.y, b.y[ i ] ), b.y[ i ] + b.h[ i ] );
+
+		//If the closest point is inside the circle
+		if( distanceSquared( a.x, a.y, cX, cY ) < a.r * a.r )
+		{
+			hits[ i / 32 ] |= 1u << ( i % 32 );
+		}
+	}
+}
+
+void checkBoxesScalar( SDL_Rect& a, BoxBatch& b, int first, Uint32* hits )
+{
+	int count = b.x.size();
+	for( int i = first; i < count; ++i )
+	{
+		if( i % 32 == 0 )
+		{
+			hits[ i / 32 ] = 0;
+		}
+
+		//If none of the sides from A are outside B
+		if( a.y + a.h > b.y[ i ] && a.y < b.y[ i ] + b.h[ i ] && a.x + a.w > b.x[ i ] && a.x < b.x[ i ] + b.w[ i ] )
+		{
+			hits[ i / 32 ] |= 1u << ( i % 32 );
+		}
+	}
+}
+
+#ifdef COLLISION_SIMD
+COLLISION_SSE41_TARGET int checkCirclesSSE41( Circle& a, CircleBatch& b, Uint32* hits )
+{
+	__m128i aX = _mm_set1_epi32( a.x );
+	__m128i aY = _mm_set1_epi32( a.y );
+	__m128i aR = _mm_set1_epi32( a.r );
+
+	//Test a word of circles at a time, 4 per step
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 4 )
+		{
+			int k = i + j;
+			__m128i dX = _mm_sub_epi32( _mm_loadu_si128( (__m128i*)&b.x[ k ] ), aX );
+			__m128i dY = _mm_sub_epi32( _mm_loadu_si128( (__m128i*)&b.y[ k ] ), aY );
+			__m128i distance = _mm_add_epi32( _mm_mullo_epi32( dX, dX ), _mm_mullo_epi32( dY, dY ) );
+			__m128i totalRadius = _mm_add_epi32( _mm_loadu_si128( (__m128i*)&b.r[ k ] ), aR );
+			__m128i hit = _mm_cmpgt_epi32( _mm_mullo_epi32( totalRadius, totalRadius ), distance );
+			bits |= (Uint32)_mm_movemask_ps( _mm_castsi128_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+
+COLLISION_SSE41_TARGET int checkCircleBoxesSSE41( Circle& a, BoxBatch& b, Uint32* hits )
+{
+	__m128i aX = _mm_set1_epi32( a.x );
+	__m128i aY = _mm_set1_epi32( a.y );
+	__m128i radiusSquared = _mm_set1_epi32( a.r * a.r );
+
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 4 )
+		{
+			int k = i + j;
+
+			//Closest point on each box
+			__m128i bX = _mm_loadu_si128( (__m128i*)&b.x[ k ] );
+			__m128i bY = _mm_loadu_si128( (__m128i*)&b.y[ k ] );
+			__m128i cX = _mm_min_epi32( _mm_max_epi32( aX, bX ), _mm_add_epi32( bX, _mm_loadu_si128( (__m128i*)&b.w[ k ] ) ) );
+			__m128i cY = _mm_min_epi32( _mm_max_epi32( aY, bY ), _mm_add_epi32( bY, _mm_loadu_si128( (__m128i*)&b.h[ k ] ) ) );
+
+			__m128i dX = _mm_sub_epi32( cX, aX );
+			__m128i dY = _mm_sub_epi32( cY, aY );
+			__m128i distance = _mm_add_epi32( _mm_mullo_epi32( dX, dX ), _mm_mullo_epi32( dY, dY ) );
+			__m128i hit = _mm_cmpgt_epi32( radiusSquared, distance );
+			bits |= (Uint32)_mm_movemask_ps( _mm_castsi128_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+
+COLLISION_SSE41_TARGET int checkBoxesSSE41( SDL_Rect& a, BoxBatch& b, Uint32* hits )
+{
+	__m128i left = _mm_set1_epi32( a.x );
+	__m128i right = _mm_set1_epi32( a.x + a.w );
+	__m128i top = _mm_set1_epi32( a.y );
+	__m128i bottom = _mm_set1_epi32( a.y + a.h );
+
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 4 )
+		{
+			int k = i + j;
+			__m128i bX = _mm_loadu_si128( (__m128i*)&b.x[ k ] );
+			__m128i bY = _mm_loadu_si128( (__m128i*)&b.y[ k ] );
+
+			//None of the sides from A are outside B
+			__m128i hit = _mm_and_si128( _mm_cmpgt_epi32( bottom, bY ), _mm_cmpgt_epi32( _mm_add_epi32( bY, _mm_loadu_si128( (__m128i*)&b.h[ k ] ) ), top ) );
+			hit = _mm_and_si128( hit, _mm_cmpgt_epi32( right, bX ) );
+			hit = _mm_and_si128( hit, _mm_cmpgt_epi32( _mm_add_epi32( bX, _mm_loadu_si128( (__m128i*)&b.w[ k ] ) ), left ) );
+			bits |= (Uint32)_mm_movemask_ps( _mm_castsi128_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+
+COLLISION_AVX2_TARGET int checkCirclesAVX2( Circle& a, CircleBatch& b, Uint32* hits )
+{
+	__m256i aX = _mm256_set1_epi32( a.x );
+	__m256i aY = _mm256_set1_epi32( a.y );
+	__m256i aR = _mm256_set1_epi32( a.r );
+
+	//Test a word of circles at a time, 8 per step
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 8 )
+		{
+			int k = i + j;
+			__m256i dX = _mm256_sub_epi32( _mm256_loadu_si256( (__m256i*)&b.x[ k ] ), aX );
+			__m256i dY = _mm256_sub_epi32( _mm256_loadu_si256( (__m256i*)&b.y[ k ] ), aY );
+			__m256i distance = _mm256_add_epi32( _mm256_mullo_epi32( dX, dX ), _mm256_mullo_epi32( dY, dY ) );
+			__m256i totalRadius = _mm256_add_epi32( _mm256_loadu_si256( (__m256i*)&b.r[ k ] ), aR );
+			__m256i hit = _mm256_cmpgt_epi32( _mm256_mullo_epi32( totalRadius, totalRadius ), distance );
+			bits |= (Uint32)_mm256_movemask_ps( _mm256_castsi256_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+
+COLLISION_AVX2_TARGET int checkCircleBoxesAVX2( Circle& a, BoxBatch& b, Uint32* hits )
+{
+	__m256i aX = _mm256_set1_epi32( a.x );
+	__m256i aY = _mm256_set1_epi32( a.y );
+	__m256i radiusSquared = _mm256_set1_epi32( a.r * a.r );
+
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 8 )
+		{
+			int k = i + j;
+
+			//Closest point on each box
+			__m256i bX = _mm256_loadu_si256( (__m256i*)&b.x[ k ] );
+			__m256i bY = _mm256_loadu_si256( (__m256i*)&b.y[ k ] );
+			__m256i cX = _mm256_min_epi32( _mm256_max_epi32( aX, bX ), _mm256_add_epi32( bX, _mm256_loadu_si256( (__m256i*)&b.w[ k ] ) ) );
+			__m256i cY = _mm256_min_epi32( _mm256_max_epi32( aY, bY ), _mm256_add_epi32( bY, _mm256_loadu_si256( (__m256i*)&b.h[ k ] ) ) );
+
+			__m256i dX = _mm256_sub_epi32( cX, aX );
+			__m256i dY = _mm256_sub_epi32( cY, aY );
+			__m256i distance = _mm256_add_epi32( _mm256_mullo_epi32( dX, dX ), _mm256_mullo_epi32( dY, dY ) );
+			__m256i hit = _mm256_cmpgt_epi32( radiusSquared, distance );
+			bits |= (Uint32)_mm256_movemask_ps( _mm256_castsi256_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+
+COLLISION_AVX2_TARGET int checkBoxesAVX2( SDL_Rect& a, BoxBatch& b, Uint32* hits )
+{
+	__m256i left = _mm256_set1_epi32( a.x );
+	__m256i right = _mm256_set1_epi32( a.x + a.w );
+	__m256i top = _mm256_set1_epi32( a.y );
+	__m256i bottom = _mm256_set1_epi32( a.y + a.h );
+
+	int count = b.x.size() / 32 * 32;
+	for( int i = 0; i < count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 8 )
+		{
+			int k = i + j;
+			__m256i bX = _mm256_loadu_si256( (__m256i*)&b.x[ k ] );
+			__m256i bY = _mm256_loadu_si256( (__m256i*)&b.y[ k ] );
+
+			//None of the sides from A are outside B
+			__m256i hit = _mm256_and_si256( _mm256_cmpgt_epi32( bottom, bY ), _mm256_cmpgt_epi32( _mm256_add_epi32( bY, _mm256_loadu_si256( (__m256i*)&b.h[ k ] ) ), top ) );
+			hit = _mm256_and_si256( hit, _mm256_cmpgt_epi32( right, bX ) );
+			hit = _mm256_and_si256( hit, _mm256_cmpgt_epi32( _mm256_add_epi32( bX, _mm256_loadu_si256( (__m256i*)&b.w[ k ] ) ), left ) );
+			bits |= (Uint32)_mm256_movemask_ps( _mm256_castsi256_ps( hit ) ) << j;
+		}
+		hits[ i / 32 ] = bits;
+	}
+
+	return count;
+}
+#endif
+
+BatchLevel pickBatchLevel()
+{
+#ifdef COLLISION_SIMD
+	if( SDL_HasAVX2() )
+	{
+		return BATCH_AVX2;
+	}
+	if( SDL_HasSSE41() )
+	{
+		return BATCH_SSE41;
+	}
+#endif
+	return BATCH_SCALAR;
+}
+
+int fuzzCollisions()
+{
+	//Fuzz settings
+	const int FUZZ_ROUNDS = 20000;
+	const int MAX_BATCH = 100;
+	const int FUZZ_RANGE = 2000;
+
+	//Instruction sets this CPU can run
+	const char* names[ 3 ] = { "scalar", "SSE4.1", "AVX2" };
+	BatchLevel supported = pickBatchLevel();
+	BatchLevel oldLevel = gBatchLevel;
+
+	int failures = 0;
+	CircleBatch circles;
+	BoxBatch boxes;
+	std::vector<Uint32> hits;
+	for( int round = 0; round < FUZZ_ROUNDS; ++round )
+	{
+		//Random shapes near each other, some of them empty
+		Circle circle = { rand() % FUZZ_RANGE, rand() % FUZZ_RANGE, rand() % 200 };
+		SDL_Rect box = { rand() % FUZZ_RANGE, rand() % FUZZ_RANGE, rand() % 300, rand() % 300 };
+		int count = rand() % MAX_BATCH;
+		circles.x.resize( count );
+		circles.y.resize( count );
+		circles.r.resize( count );
+		boxes.x.resize( count );
+		boxes.y.resize( count );
+		boxes.w.resize( count );
+		boxes.h.resize( count );
+		for( int i = 0; i < count; ++i )
+		{
+			circles.x[ i ] = rand() % FUZZ_RANGE;
+			circles.y[ i ] = rand() % FUZZ_RANGE;
+			circles.r[ i ] = rand() % 200;
+			boxes.x[ i ] = rand() % FUZZ_RANGE;
+			boxes.y[ i ] = rand() % FUZZ_RANGE;
+			boxes.w[ i ] = rand() % 300;
+			boxes.h[ i ] = rand() % 300;
+		}
+		hits.resize( count / 32 + 1 );
+
+		//Every instruction set has to agree with the single shape detectors
+		for( int level = BATCH_SCALAR; level <= supported; ++level )
+		{
+			gBatchLevel = (BatchLevel)level;
+			for( int test = 0; test < 3; ++test )
+			{
+				if( test == 0 )
+				{
+					checkCollisions( circle, circles, &hits[ 0 ] );
+				}
+				else if( test == 1 )
+				{
+					checkCollisions( circle, boxes, &hits[ 0 ] );
+				}
+				else
+				{
+					checkCollisions( box, boxes, &hits[ 0 ] );
+				}
+
+				for( int i = 0; i < count; ++i )
+				{
+					Circle other = { circles.x[ i ], circles.y[ i ], circles.r[ i ] };
+					SDL_Rect otherBox = { boxes.x[ i ], boxes.y[ i ], boxes.w[ i ], boxes.h[ i ] };
+					bool expected;
+					if( test == 0 )
+					{
+						expected = checkCollision( circle, other );
+					}
+					else if( test == 1 )
+					{
+						expected = checkCollision( circle, otherBox );
+					}
+					else
+					{
+						expected = checkCollision( box, otherBox );
+					}
+
+					bool hit = ( hits[ i / 32 ] >> ( i % 32 ) ) & 1;
+					if( hit != expected )
+					{
+						printf( "%s batch test %d disagrees on shape %d of round %d!\n", names[ level ], test, i, round );
+						++failures;
+					}
+				}
+			}
+		}
+	}
+	gBatchLevel = oldLevel;
+
+	printf( "Fuzzed %d rounds on %s and below, %d failures\n", FUZZ_ROUNDS, names[ supported ], failures );
+	return failures == 0 ? 0 : 1;
+}
+
 //Main loop flag
 bool quit = false;
 
@@ -561,7 +1823,7 @@ void loop_handler(void*)
 	}
 
 	//Move the dot and check collision
-	dot.move( wall, otherDot.getCollider() );
+	dot.move();
 
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
@@ -582,6 +1844,12 @@ void loop_handler(void*)
  
 int main( int argc, char* args[] )
 {
+	//Check the batch collision detectors instead of running the demo
+	if( argc > 1 && strcmp( args[ 1 ], "--fuzz" ) == 0 )
+	{
+		return fuzzCollisions();
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -600,6 +1868,9 @@ int main( int argc, char* args[] )
 			wall.y = 40;
 			wall.w = 40;
 			wall.h = 400;
+
+			//Add the wall to the collision tree
+			gColliders.insert( wall );
 #ifdef _JS
 
                         emscripten_set_main_loop_arg(loop_handler, NULL, -1, 1);
@@ -1,13 +1,16 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, SDL_ttf, standard IO, strings, and string streams
+//Using SDL, SDL_image, SDL_ttf, standard IO, strings, string streams, vectors, maps, and algorithms
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -16,6 +19,9 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Glyph atlas page dimensions
+const int ATLAS_PAGE_SIZE = 512;
+
 //Texture wrapper class
 class LTexture
 {
@@ -62,6 +68,151 @@ class LTexture
 		int mHeight;
 };
 
+#ifdef _SDL_TTF_H
+//Caches a font's glyphs in texture pages so text can be drawn without rendering new surfaces
+class LGlyphAtlas
+{
+	public:
+		//Initializes variables
+		LGlyphAtlas();
+
+		//Deallocates memory
+		~LGlyphAtlas();
+
+		//Sets the font glyphs are rasterized from, dropping glyphs from the previous one
+		void setFont( TTF_Font* font );
+
+		//Deallocates pages and forgets cached glyphs
+		void free();
+
+		//Renders UTF-8 text at given point, caching glyphs that haven't been seen yet
+		void render( int x, int y, const std::string& text, SDL_Color color );
+
+		//Gets how far a character moves the pen
+		int getAdvance( Uint16 c );
+
+		//Gets text dimensions
+		int getTextWidth( const std::string& text );
+		int getTextHeight();
+
+		//Gets the number of texture pages in use
+		int getPageCount();
+
+	private:
+		//Where a glyph lives in the pages
+		struct Glyph
+		{
+			bool cached;
+			int page;
+			SDL_Rect clip;
+			int advance;
+		};
+
+		//Gets the glyph for a character, rasterizing it on first use
+		Glyph& getGlyph( Uint16 c );
+
+		//Rasterizes a glyph into the current page, opening a new one if it's full
+		bool addGlyph( Glyph& glyph, Uint16 c );
+
+		//Opens a new page with every pixel cleared
+		bool addPage();
+
+		//The font glyphs come from
+		TTF_Font* mFont;
+
+		//Glyphs for every Latin-1 character
+		Glyph mGlyphs[ 256 ];
+
+		//Glyphs for the rest of the characters that have been used
+		std::map<Uint16, Glyph> mExtraGlyphs;
+
+		//The texture pages glyphs are packed into
+		std::vector<SDL_Texture*> mPages;
+
+		//Where the next glyph goes in the last page
+		int mPenX;
+		int mPenY;
+		int mShelfHeight;
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+		//Queues a glyph's quad in the given color
+		void queueGlyph( Glyph& glyph, int x, int y, SDL_Color color );
+
+		//Draws the queued quads from a page in one geometry call and empties the queue
+		void flushGlyphs( int page );
+
+		//Four vertices and six indices per queued glyph, kept between draws
+		std::vector<SDL_Vertex> mVertices;
+		std::vector<int> mIndices;
+#endif
+};
+#endif
+
+#ifdef _SDL_TTF_H
+//Editable UTF-8 text kept in a gap buffer along with each character's advance
+//Edits at the cursor only move the gap and measure the characters they add
+class LTextField
+{
+	public:
+		//Initializes variables
+		LTextField();
+
+		//Sets the glyphs characters are measured and drawn with
+		void setAtlas( LGlyphAtlas* atlas );
+
+		//Replaces the text and puts the cursor at the end
+		void setText( const std::string& text );
+
+		//Inserts text at the cursor
+		void insert( const std::string& text );
+
+		//Removes the character before the cursor
+		void erase();
+
+		//Moves the cursor by a number of characters
+		void moveCursor( int offset );
+
+		//Gets the text
+		std::string getText();
+		int getLength();
+
+		//Renders the text wrapped into centered lines of the given width, scrolled so the cursor stays on screen
+		void render( int y, int width, SDL_Color color );
+
+	private:
+		//Moves the gap to a text position
+		void moveGap( int position );
+
+		//Grows the gap so it holds at least count characters
+		void makeRoom( int count );
+
+		//Gets the byte and advance at a text position
+		char getChar( int index );
+		int getAdvance( int index );
+
+		//Gets the text position of the character before or after a position
+		int getPreviousChar( int index );
+		int getNextChar( int index );
+
+		//The glyphs characters are measured and drawn with
+		LGlyphAtlas* mAtlas;
+
+		//Bytes and their advances with the gap at the cursor
+		//A character's advance is stored on its first byte, the rest of its bytes advance nothing
+		std::vector<char> mChars;
+		std::vector<int> mAdvances;
+		int mGapStart;
+		int mGapEnd;
+
+		//Where each wrapped line starts and the line at the top of the screen
+		std::vector<int> mLineStarts;
+		int mFirstLine;
+
+		//The line being drawn, kept between draws
+		std::string mLine;
+};
+#endif
+
 //Starts up SDL and creates window
 bool init();
 
@@ -71,6 +222,10 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Decodes the UTF-8 character at a position and moves the position past it
+//Malformed bytes and characters outside the Basic Multilingual Plane come back as U+FFFD
+Uint16 readUTF8( const char* text, int length, int& position );
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -82,7 +237,10 @@ TTF_Font *gFont = NULL;
 
 //Scene textures
 LTexture gPromptTextTexture;
-LTexture gInputTextTexture;
+
+//Cached glyphs and the text being edited with them
+LGlyphAtlas gInputGlyphs;
+LTextField gInputText;
 
 LTexture::LTexture()
 {
@@ -232,6 +390,583 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+#ifdef _SDL_TTF_H
+LGlyphAtlas::LGlyphAtlas()
+{
+	//Initialize
+	mFont = NULL;
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+	for( int i = 0; i < 256; ++i )
+	{
+		mGlyphs[ i ].cached = false;
+	}
+}
+
+LGlyphAtlas::~LGlyphAtlas()
+{
+	//Deallocate
+	free();
+}
+
+void LGlyphAtlas::setFont( TTF_Font* font )
+{
+	//Glyphs from another font are no use
+	free();
+	mFont = font;
+}
+
+void LGlyphAtlas::free()
+{
+	//Free pages
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		SDL_DestroyTexture( mPages[ i ] );
+	}
+	mPages.clear();
+
+	//Forget glyphs
+	for( int i = 0; i < 256; ++i )
+	{
+		mGlyphs[ i ].cached = false;
+	}
+	mExtraGlyphs.clear();
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+}
+
+void LGlyphAtlas::render( int x, int y, const std::string& text, SDL_Color color )
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Queue the glyphs colored by their vertices and draw each run from one page at once
+	int penX = x;
+	int batchPage = -1;
+	int position = 0;
+	while( position < (int)text.size() )
+	{
+		Glyph& glyph = getGlyph( readUTF8( text.c_str(), text.size(), position ) );
+		if( glyph.clip.w > 0 )
+		{
+			//Glyphs from another page can't share the draw call
+			if( glyph.page != batchPage )
+			{
+				flushGlyphs( batchPage );
+				batchPage = glyph.page;
+			}
+			queueGlyph( glyph, penX, y, color );
+		}
+		penX += glyph.advance;
+	}
+	flushGlyphs( batchPage );
+#else
+	//Cache new glyphs first so every page they land in gets colored
+	int position = 0;
+	while( position < (int)text.size() )
+	{
+		getGlyph( readUTF8( text.c_str(), text.size(), position ) );
+	}
+
+	//Glyphs are cached white so any color is just a modulation
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		SDL_SetTextureColorMod( mPages[ i ], color.r, color.g, color.b );
+		SDL_SetTextureAlphaMod( mPages[ i ], color.a );
+	}
+
+	//Draw each glyph from its page, consecutive copies from the same texture get batched by the renderer
+	int penX = x;
+	position = 0;
+	while( position < (int)text.size() )
+	{
+		Glyph& glyph = getGlyph( readUTF8( text.c_str(), text.size(), position ) );
+		if( glyph.clip.w > 0 )
+		{
+			SDL_Rect renderQuad = { penX, y, glyph.clip.w, glyph.clip.h };
+			SDL_RenderCopy( gRenderer, mPages[ glyph.page ], &glyph.clip, &renderQuad );
+		}
+		penX += glyph.advance;
+	}
+#endif
+}
+
+int LGlyphAtlas::getAdvance( Uint16 c )
+{
+	return getGlyph( c ).advance;
+}
+
+int LGlyphAtlas::getTextWidth( const std::string& text )
+{
+	//Add up the advances
+	int width = 0;
+	int position = 0;
+	while( position < (int)text.size() )
+	{
+		width += getGlyph( readUTF8( text.c_str(), text.size(), position ) ).advance;
+	}
+
+	return width;
+}
+
+int LGlyphAtlas::getTextHeight()
+{
+	return mFont != NULL ? TTF_FontHeight( mFont ) : 0;
+}
+
+int LGlyphAtlas::getPageCount()
+{
+	return (int)mPages.size();
+}
+
+LGlyphAtlas::Glyph& LGlyphAtlas::getGlyph( Uint16 c )
+{
+	//Latin-1 glyphs are looked up directly, new entries for the rest start out uncached
+	Glyph& glyph = c < 256 ? mGlyphs[ c ] : mExtraGlyphs[ c ];
+	if( !glyph.cached )
+	{
+		//Only try once, a glyph that failed to cache is drawn as nothing
+		glyph.cached = true;
+		glyph.page = 0;
+		glyph.clip.x = 0;
+		glyph.clip.y = 0;
+		glyph.clip.w = 0;
+		glyph.clip.h = 0;
+		glyph.advance = 0;
+		if( mFont != NULL && !addGlyph( glyph, c ) )
+		{
+			printf( "Unable to cache glyph %d!\n", c );
+		}
+	}
+
+	return glyph;
+}
+
+bool LGlyphAtlas::addGlyph( Glyph& glyph, Uint16 c )
+{
+	//Get how far the glyph moves the pen
+	int minX, maxX, minY, maxY;
+	if( TTF_GlyphMetrics( mFont, c, &minX, &maxX, &minY, &maxY, &glyph.advance ) == -1 )
+	{
+		printf( "Unable to get glyph metrics! SDL_ttf Error: %s\n", TTF_GetError() );
+		return false;
+	}
+
+	//Render the glyph in white, it gets colored when drawn
+	SDL_Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+	SDL_Surface* glyphSurface = TTF_RenderGlyph_Blended( mFont, c, white );
+	if( glyphSurface == NULL )
+	{
+		//Blank glyphs like spaces have nothing to render
+		return glyph.advance > 0;
+	}
+
+	bool success = true;
+	if( glyphSurface->w > ATLAS_PAGE_SIZE || glyphSurface->h > ATLAS_PAGE_SIZE )
+	{
+		printf( "Glyph %d doesn't fit in an atlas page!\n", c );
+		success = false;
+	}
+	else
+	{
+		//Start a new shelf when the glyph doesn't fit on this one
+		if( mPenX + glyphSurface->w > ATLAS_PAGE_SIZE )
+		{
+			mPenX = 0;
+			mPenY += mShelfHeight;
+			mShelfHeight = 0;
+		}
+
+		//Start a new page when the glyph doesn't fit below the last shelf
+		if( mPages.empty() || mPenY + glyphSurface->h > ATLAS_PAGE_SIZE )
+		{
+			success = addPage();
+		}
+
+		if( success )
+		{
+			//Upload the glyph into its spot
+			SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( glyphSurface, SDL_PIXELFORMAT_ARGB8888, 0 );
+			if( formattedSurface == NULL )
+			{
+				printf( "Unable to convert glyph surface! SDL Error: %s\n", SDL_GetError() );
+				success = false;
+			}
+			else
+			{
+				SDL_Rect clip = { mPenX, mPenY, formattedSurface->w, formattedSurface->h };
+				if( SDL_UpdateTexture( mPages.back(), &clip, formattedSurface->pixels, formattedSurface->pitch ) != 0 )
+				{
+					printf( "Unable to upload glyph! SDL Error: %s\n", SDL_GetError() );
+					success = false;
+				}
+				else
+				{
+					glyph.page = (int)mPages.size() - 1;
+					glyph.clip = clip;
+
+					//Move the pen past the glyph, leaving a gap so filtering doesn't bleed between glyphs
+					mPenX += clip.w + 1;
+					mShelfHeight = SDL_max( mShelfHeight, clip.h + 1 );
+				}
+
+				SDL_FreeSurface( formattedSurface );
+			}
+		}
+	}
+
+	//Get rid of the glyph surface
+	SDL_FreeSurface( glyphSurface );
+
+	return success;
+}
+
+bool LGlyphAtlas::addPage()
+{
+	SDL_Texture* page = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE );
+	if( page == NULL )
+	{
+		printf( "Unable to create atlas page! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+
+	//New textures hold whatever was in memory, clear them so filtering at glyph edges only picks up transparent pixels
+	std::vector<Uint32> blank( ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 0 );
+	if( SDL_UpdateTexture( page, NULL, &blank[ 0 ], ATLAS_PAGE_SIZE * 4 ) != 0 )
+	{
+		printf( "Unable to clear atlas page! SDL Error: %s\n", SDL_GetError() );
+		SDL_DestroyTexture( page );
+		return false;
+	}
+
+	SDL_SetTextureBlendMode( page, SDL_BLENDMODE_BLEND );
+	mPages.push_back( page );
+	mPenX = 0;
+	mPenY = 0;
+	mShelfHeight = 0;
+	return true;
+}
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+void LGlyphAtlas::queueGlyph( Glyph& glyph, int x, int y, SDL_Color color )
+{
+	//Texture coordinates of the glyph in its page
+	float u0 = (float)glyph.clip.x / ATLAS_PAGE_SIZE;
+	float v0 = (float)glyph.clip.y / ATLAS_PAGE_SIZE;
+	float u1 = (float)( glyph.clip.x + glyph.clip.w ) / ATLAS_PAGE_SIZE;
+	float v1 = (float)( glyph.clip.y + glyph.clip.h ) / ATLAS_PAGE_SIZE;
+
+	//Corners of the quad
+	float cornerX[ 4 ] = { 0.f, (float)glyph.clip.w, (float)glyph.clip.w, 0.f };
+	float cornerY[ 4 ] = { 0.f, 0.f, (float)glyph.clip.h, (float)glyph.clip.h };
+	float cornerU[ 4 ] = { u0, u1, u1, u0 };
+	float cornerV[ 4 ] = { v0, v0, v1, v1 };
+
+	//Queue the two triangles of the quad
+	int first = mVertices.size();
+	for( int i = 0; i < 4; ++i )
+	{
+		SDL_Vertex vertex;
+		vertex.position.x = x + cornerX[ i ];
+		vertex.position.y = y + cornerY[ i ];
+		vertex.color = color;
+		vertex.tex_coord.x = cornerU[ i ];
+		vertex.tex_coord.y = cornerV[ i ];
+		mVertices.push_back( vertex );
+	}
+
+	mIndices.push_back( first );
+	mIndices.push_back( first + 1 );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first + 3 );
+}
+
+void LGlyphAtlas::flushGlyphs( int page )
+{
+	//Draw every queued glyph at once, the glyphs are white so the vertex colors show through
+	if( !mIndices.empty() )
+	{
+		SDL_RenderGeometry( gRenderer, mPages[ page ], &mVertices[ 0 ], mVertices.size(), &mIndices[ 0 ], mIndices.size() );
+	}
+
+	//Empty the queue but keep its memory
+	mVertices.clear();
+	mIndices.clear();
+}
+#endif
+#endif
+
+#ifdef _SDL_TTF_H
+LTextField::LTextField()
+{
+	//Initialize
+	mAtlas = NULL;
+	mGapStart = 0;
+	mGapEnd = 0;
+	mFirstLine = 0;
+}
+
+void LTextField::setAtlas( LGlyphAtlas* atlas )
+{
+	mAtlas = atlas;
+
+	//Measure the text with the new glyphs, characters never straddle the gap
+	for( int i = 0; i < (int)mChars.size(); ++i )
+	{
+		if( i == mGapStart )
+		{
+			i = mGapEnd - 1;
+			continue;
+		}
+
+		mAdvances[ i ] = 0;
+		if( mAtlas != NULL && ( mChars[ i ] & 0xC0 ) != 0x80 )
+		{
+			int position = i;
+			mAdvances[ i ] = mAtlas->getAdvance( readUTF8( &mChars[ 0 ], mChars.size(), position ) );
+		}
+	}
+}
+
+void LTextField::setText( const std::string& text )
+{
+	//Empty the buffer, the gap covers all of it
+	mGapStart = 0;
+	mGapEnd = mChars.size();
+	insert( text );
+}
+
+void LTextField::insert( const std::string& text )
+{
+	//Fill the front of the gap a character at a time
+	int position = 0;
+	while( position < (int)text.length() )
+	{
+		int start = position;
+		Uint16 c = readUTF8( text.c_str(), text.length(), position );
+
+		//Anything that can't be drawn is stored as the replacement character so the buffer stays valid UTF-8
+		const char* bytes = text.c_str() + start;
+		int count = position - start;
+		if( c == 0xFFFD )
+		{
+			bytes = "\xEF\xBF\xBD";
+			count = 3;
+		}
+
+		//Only the first byte moves the pen
+		makeRoom( count );
+		for( int i = 0; i < count; ++i )
+		{
+			mChars[ mGapStart ] = bytes[ i ];
+			mAdvances[ mGapStart ] = 0;
+			++mGapStart;
+		}
+		mAdvances[ mGapStart - count ] = mAtlas != NULL ? mAtlas->getAdvance( c ) : 0;
+	}
+}
+
+void LTextField::erase()
+{
+	//Widen the gap over every byte of the character before it
+	mGapStart = getPreviousChar( mGapStart );
+}
+
+void LTextField::moveCursor( int offset )
+{
+	//Step a whole character at a time
+	int position = mGapStart;
+	for( ; offset < 0; ++offset )
+	{
+		position = getPreviousChar( position );
+	}
+	for( ; offset > 0; --offset )
+	{
+		position = getNextChar( position );
+	}
+	moveGap( position );
+}
+
+std::string LTextField::getText()
+{
+	//Join the text on both sides of the gap
+	std::string text( mChars.begin(), mChars.begin() + mGapStart );
+	text.append( mChars.begin() + mGapEnd, mChars.end() );
+	return text;
+}
+
+int LTextField::getLength()
+{
+	return mChars.size() - ( mGapEnd - mGapStart );
+}
+
+void LTextField::render( int y, int width, SDL_Color color )
+{
+	if( mAtlas == NULL )
+	{
+		return;
+	}
+
+	//Break the whole text into lines from the stored advances
+	int length = getLength();
+	mLineStarts.clear();
+	int lineStart = 0;
+	do
+	{
+		//Take characters until the line is full, always at least one and never part of one
+		mLineStarts.push_back( lineStart );
+		int lineWidth = 0;
+		int lineEnd = lineStart;
+		while( lineEnd < length && ( lineEnd == lineStart || getAdvance( lineEnd ) == 0 || lineWidth + getAdvance( lineEnd ) <= width ) )
+		{
+			lineWidth += getAdvance( lineEnd );
+			++lineEnd;
+		}
+		lineStart = lineEnd;
+	} while( lineStart < length );
+
+	//Find the line the cursor is on, a cursor at a line break sits at the start of the next line
+	int lineCount = mLineStarts.size();
+	int cursorLine = std::upper_bound( mLineStarts.begin(), mLineStarts.end(), mGapStart ) - mLineStarts.begin() - 1;
+
+	//Scroll as little as possible to keep the cursor's line on screen
+	int lineHeight = mAtlas->getTextHeight();
+	int visibleLines = lineHeight > 0 ? SDL_max( 1, ( SCREEN_HEIGHT - y ) / lineHeight ) : 1;
+	mFirstLine = SDL_min( mFirstLine, SDL_max( 0, lineCount - visibleLines ) );
+	if( cursorLine < mFirstLine )
+	{
+		mFirstLine = cursorLine;
+	}
+	else if( cursorLine >= mFirstLine + visibleLines )
+	{
+		mFirstLine = cursorLine - visibleLines + 1;
+	}
+
+	//Draw the lines on screen
+	int cursorX = 0, cursorY = 0;
+	int lastLine = SDL_min( lineCount, mFirstLine + visibleLines );
+	for( int line = mFirstLine; line < lastLine; ++line )
+	{
+		int lineEnd = line + 1 < lineCount ? mLineStarts[ line + 1 ] : length;
+
+		//Gather the line
+		int lineWidth = 0;
+		mLine.clear();
+		for( int i = mLineStarts[ line ]; i < lineEnd; ++i )
+		{
+			mLine.push_back( getChar( i ) );
+			lineWidth += getAdvance( i );
+		}
+
+		//Draw the line centered in one go
+		int lineX = ( SCREEN_WIDTH - lineWidth ) / 2;
+		mAtlas->render( lineX, y, mLine, color );
+
+		//The cursor sits before the character after the gap
+		if( line == cursorLine )
+		{
+			cursorX = lineX;
+			for( int i = mLineStarts[ line ]; i < mGapStart; ++i )
+			{
+				cursorX += getAdvance( i );
+			}
+			cursorY = y;
+		}
+
+		y += lineHeight;
+	}
+
+	//Draw the cursor
+	SDL_Rect cursor = { cursorX, cursorY, 2, lineHeight };
+	SDL_SetRenderDrawColor( gRenderer, color.r, color.g, color.b, color.a );
+	SDL_RenderFillRect( gRenderer, &cursor );
+}
+
+void LTextField::moveGap( int position )
+{
+	//Move the characters between the cursor and the new position across the gap
+	if( position < mGapStart )
+	{
+		int count = mGapStart - position;
+		std::copy_backward( mChars.begin() + position, mChars.begin() + mGapStart, mChars.begin() + mGapEnd );
+		std::copy_backward( mAdvances.begin() + position, mAdvances.begin() + mGapStart, mAdvances.begin() + mGapEnd );
+		mGapStart -= count;
+		mGapEnd -= count;
+	}
+	else if( position > mGapStart )
+	{
+		int count = position - mGapStart;
+		std::copy( mChars.begin() + mGapEnd, mChars.begin() + mGapEnd + count, mChars.begin() + mGapStart );
+		std::copy( mAdvances.begin() + mGapEnd, mAdvances.begin() + mGapEnd + count, mAdvances.begin() + mGapStart );
+		mGapStart += count;
+		mGapEnd += count;
+	}
+}
+
+void LTextField::makeRoom( int count )
+{
+	if( mGapEnd - mGapStart >= count )
+	{
+		return;
+	}
+
+	//Grow by at least double so typing doesn't reallocate every keystroke
+	int oldSize = mChars.size();
+	int newSize = SDL_max( oldSize * 2, oldSize + count + 64 );
+	int tail = oldSize - mGapEnd;
+	mChars.resize( newSize );
+	mAdvances.resize( newSize );
+
+	//Move the text after the gap to the end
+	std::copy_backward( mChars.begin() + mGapEnd, mChars.begin() + oldSize, mChars.end() );
+	std::copy_backward( mAdvances.begin() + mGapEnd, mAdvances.begin() + oldSize, mAdvances.end() );
+	mGapEnd = newSize - tail;
+}
+
+char LTextField::getChar( int index )
+{
+	return mChars[ index < mGapStart ? index : index + ( mGapEnd - mGapStart ) ];
+}
+
+int LTextField::getAdvance( int index )
+{
+	return mAdvances[ index < mGapStart ? index : index + ( mGapEnd - mGapStart ) ];
+}
+
+int LTextField::getPreviousChar( int index )
+{
+	//Back up to the first byte of the character
+	if( index > 0 )
+	{
+		--index;
+		while( index > 0 && ( getChar( index ) & 0xC0 ) == 0x80 )
+		{
+			--index;
+		}
+	}
+
+	return index;
+}
+
+int LTextField::getNextChar( int index )
+{
+	//Skip the first byte and the rest of the character after it
+	int length = getLength();
+	if( index < length )
+	{
+		++index;
+		while( index < length && ( getChar( index ) & 0xC0 ) == 0x80 )
+		{
+			++index;
+		}
+	}
+
+	return index;
+}
+#endif
+
 bool init()
 {
 	//Initialization flag
@@ -322,6 +1057,11 @@ bool loadMedia()
 			printf( "Failed to render prompt text!\n" );
 			success = false;
 		}
+
+		//Set up the input text
+		gInputGlyphs.setFont( gFont );
+		gInputText.setAtlas( &gInputGlyphs );
+		gInputText.setText( "Some Text" );
 	}
 
 	return success;
@@ -331,7 +1071,7 @@ void close()
 {
 	//Free loaded images
 	gPromptTextTexture.free();
-	gInputTextTexture.free();
+	gInputGlyphs.free();
 
 	//Free global font
 	TTF_CloseFont( gFont );
@@ -349,23 +1089,76 @@ void close()
 	SDL_Quit();
 }
 
+Uint16 readUTF8( const char* text, int length, int& position )
+{
+	//The first byte says how many continuation bytes follow
+	Uint8 lead = text[ position ];
+	int count = 0;
+	Uint32 c = 0;
+	if( lead < 0x80 )
+	{
+		++position;
+		return lead;
+	}
+	else if( lead >= 0xC2 && lead <= 0xDF )
+	{
+		count = 1;
+		c = lead & 0x1F;
+	}
+	else if( lead >= 0xE0 && lead <= 0xEF )
+	{
+		count = 2;
+		c = lead & 0x0F;
+	}
+	else if( lead >= 0xF0 && lead <= 0xF4 )
+	{
+		count = 3;
+		c = lead & 0x07;
+	}
+	else
+	{
+		++position;
+		return 0xFFFD;
+	}
+
+	//A sequence cut short only loses its first byte
+	if( position + count >= length )
+	{
+		++position;
+		return 0xFFFD;
+	}
+	for( int i = 1; i <= count; ++i )
+	{
+		Uint8 next = text[ position + i ];
+		if( ( next & 0xC0 ) != 0x80 )
+		{
+			++position;
+			return 0xFFFD;
+		}
+		c = ( c << 6 ) | ( next & 0x3F );
+	}
+	position += count + 1;
+
+	//Overlong forms, surrogates, and anything past the BMP can't be drawn
+	if( ( count == 2 && c < 0x800 ) || ( c >= 0xD800 && c <= 0xDFFF ) || c > 0xFFFF )
+	{
+		return 0xFFFD;
+	}
+
+	return c;
+}
+
 //Main loop flag
 bool quit = false;
 
 //Set text color as black
 SDL_Color textColor = { 0, 0, 0, 0xFF };
 
-//The current input text.
-std::string inputText = "Some Text";
-
 void loop_handler(void*)
 {
 	//Event handler
 	SDL_Event e;
 
-	//The rerender text flag
-	bool renderText = false;
-
 	//Handle events on queue
 	while( SDL_PollEvent( &e ) != 0 )
 	{
@@ -378,22 +1171,35 @@ void loop_handler(void*)
 		else if( e.type == SDL_KEYDOWN )
 		{
 			//Handle backspace
-			if( e.key.keysym.sym == SDLK_BACKSPACE && inputText.length() > 0 )
+			if( e.key.keysym.sym == SDLK_BACKSPACE )
+			{
+				//lop off character before the cursor
+				gInputText.erase();
+			}
+			//Handle cursor movement
+			else if( e.key.keysym.sym == SDLK_LEFT )
 			{
-				//lop off character
-				inputText.pop_back();
-				renderText = true;
+				gInputText.moveCursor( -1 );
+			}
+			else if( e.key.keysym.sym == SDLK_RIGHT )
+			{
+				gInputText.moveCursor( 1 );
 			}
 			//Handle copy
 			else if( e.key.keysym.sym == SDLK_c && SDL_GetModState() & KMOD_CTRL )
 			{
-				SDL_SetClipboardText( inputText.c_str() );
+				SDL_SetClipboardText( gInputText.getText().c_str() );
 			}
 			//Handle paste
 			else if( e.key.keysym.sym == SDLK_v && SDL_GetModState() & KMOD_CTRL )
 			{
-				inputText = SDL_GetClipboardText();
-				renderText = true;
+				//Insert the clipboard at the cursor
+				char* clipboardText = SDL_GetClipboardText();
+				if( clipboardText != NULL )
+				{
+					gInputText.insert( clipboardText );
+					SDL_free( clipboardText );
+				}
 			}
 		}
 		//Special text input event
@@ -402,37 +1208,19 @@ void loop_handler(void*)
 			//Not copy or pasting
 			if( !( ( e.text.text[ 0 ] == 'c' || e.text.text[ 0 ] == 'C' ) && ( e.text.text[ 0 ] == 'v' || e.text.text[ 0 ] == 'V' ) && SDL_GetModState() & KMOD_CTRL ) )
 			{
-				//Append character
-				inputText += e.text.text;
-				renderText = true;
+				//Insert character at the cursor
+				gInputText.insert( e.text.text );
 			}
 		}
 	}
 
-	//Rerender text if needed
-	if( renderText )
-	{
-		//Text is not empty
-		if( inputText != "" )
-		{
-			//Render new text
-			gInputTextTexture.loadFromRenderedText( inputText.c_str(), textColor );
-		}
-		//Text is empty
-		else
-		{
-			//Render space texture
-			gInputTextTexture.loadFromRenderedText( " ", textColor );
-		}
-	}
-
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
-	//Render text textures
+	//Render text
 	gPromptTextTexture.render( ( SCREEN_WIDTH - gPromptTextTexture.getWidth() ) / 2, 0 );
-	gInputTextTexture.render( ( SCREEN_WIDTH - gInputTextTexture.getWidth() ) / 2, gPromptTextTexture.getHeight() );
+	gInputText.render( gPromptTextTexture.getHeight(), SCREEN_WIDTH, textColor );
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -455,10 +1243,6 @@ int main( int argc, char* args[] )
 		}
 		else
 		{	
-
-			
-			gInputTextTexture.loadFromRenderedText( inputText.c_str(), textColor );
-
 			//Enable text input
 			SDL_StartTextInput();
 #ifdef _JS
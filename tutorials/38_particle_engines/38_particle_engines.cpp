@@ -1,22 +1,96 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, and strings
+//Using SDL, SDL_image, standard IO, standard math, C strings, file info, strings, file streams, maps, vectors, and sorting
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <string>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <algorithm>
 #ifdef _JS
 #include <emscripten.h>
 #endif
 
+//SIMD particle kernels are built on x86 targets with SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PARTICLE_SIMD
+#include <immintrin.h>
+
+//The AVX2 kernel is compiled for AVX2 and only called when the CPU has it
+#ifdef __GNUC__
+#define PARTICLE_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#else
+#define PARTICLE_AVX2_TARGET
+#endif
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
-//Particle count
+//Particles kept alive around each dot
 const int TOTAL_PARTICLES = 20;
 
+//Number of dots drifting around on their own
+const int TOTAL_WANDERERS = 8;
+
+//The particle images in the particle atlas
+const int PARTICLE_RED = 0;
+const int PARTICLE_GREEN = 1;
+const int PARTICLE_BLUE = 2;
+const int PARTICLE_SHIMMER = 3;
+const int TOTAL_PARTICLE_IMAGES = 4;
+
+//A texture shared between every LTexture loaded from the same file
+struct LCachedTexture
+{
+	//The cache key this texture is stored under
+	std::string key;
+
+	//The shared hardware texture
+	SDL_Texture* texture;
+
+	//Image dimensions
+	int width;
+	int height;
+
+	//Number of LTextures holding this texture
+	int refCount;
+};
+
+//Reference counted cache of textures loaded from files
+class LTextureCache
+{
+	public:
+		//Deallocates any textures still resident
+		~LTextureCache();
+
+		//Gets the texture for the path and color key, loading it only if it is not resident
+		LCachedTexture* acquire( std::string path, bool colorKey, Uint8 keyRed, Uint8 keyGreen, Uint8 keyBlue );
+
+		//Drops a reference and frees the texture once the last holder is gone
+		void release( LCachedTexture* entry );
+
+		//Frees every resident texture nobody holds, held textures are freed by their last release
+		void clear();
+
+		//Gets number of resident textures
+		int getSize();
+
+	private:
+		//Builds the lookup key from the path and color key settings
+		static std::string makeKey( std::string path, bool colorKey, Uint8 keyRed, Uint8 keyGreen, Uint8 keyBlue );
+
+		//The resident textures
+		std::map<std::string, LCachedTexture*> mEntries;
+};
+
 //Texture wrapper class
 class LTexture
 {
@@ -27,14 +101,18 @@ class LTexture
 		//Deallocates memory
 		~LTexture();
 
-		//Loads image at specified path
-		bool loadFromFile( std::string path );
+		//Loads image at specified path through the shared texture cache
+		//Color and alpha modulation is shared by every LTexture loaded from the same file
+		bool loadFromFile( std::string path, bool colorKey = true, Uint8 keyRed = 0, Uint8 keyGreen = 0xFF, Uint8 keyBlue = 0xFF );
 		
 		#ifdef _SDL_TTF_H
 		//Creates image from font string
 		bool loadFromRenderedText( std::string textureText, SDL_Color textColor );
 		#endif
 
+		//Creates texture from surface pixels
+		bool loadFromSurface( SDL_Surface* surface );
+
 		//Deallocates texture
 		void free();
 
@@ -58,32 +136,223 @@ class LTexture
 		//The actual hardware texture
 		SDL_Texture* mTexture;
 
+		//The cache entry the texture belongs to, NULL if the texture is owned
+		LCachedTexture* mCacheEntry;
+
 		//Image dimensions
 		int mWidth;
 		int mHeight;
 };
 
-class Particle
+//An image packed into a texture atlas
+struct LAtlasImage
+{
+	//Path the image was loaded from
+	std::string path;
+
+	//Page the image is packed into
+	int page;
+
+	//Location of the image on the page
+	SDL_Rect clip;
+};
+
+//Packs loose images into a few large texture pages at load time
+class LTextureAtlas
+{
+	public:
+		//Initializes variables
+		LTextureAtlas();
+
+		//Deallocates pages
+		~LTextureAtlas();
+
+		//Queues an image for packing and returns its index
+		int addImage( std::string path );
+
+		//Packs the queued images into pages, reusing the pages cached at cachePath when the sources haven't changed
+		bool build( int pageWidth, int pageHeight, std::string cachePath = "" );
+
+		//Gets the page an image was packed into
+		LTexture* getTexture( int image );
+
+		//Gets the clip of an image for LTexture::render
+		SDL_Rect* getClip( int image );
+
+		//Gets a page by index
+		LTexture* getPage( int page );
+
+		//Gets number of pages
+		int getPageCount();
+
+		//Deallocates pages and forgets the images
+		void free();
+
+	private:
+		//A segment of the packed outline of a page
+		struct SkylineNode
+		{
+			int x, y, width;
+		};
+
+		//Finds the lowest position on the skyline a rectangle fits at, returns the node index or -1
+		static int findPosition( std::vector<SkylineNode>& skyline, int pageWidth, int pageHeight, int width, int height, int& x, int& y );
+
+		//Raises the skyline over a placed rectangle
+		static void addRect( std::vector<SkylineNode>& skyline, int node, int x, int y, int width, int height );
+
+		//Loads the cached pages if they were built from the current images
+		bool loadCache( int pageWidth, int pageHeight, std::string cachePath );
+
+		//Saves the pages and their layout
+		void saveCache( int pageWidth, int pageHeight, std::string cachePath, std::vector<SDL_Surface*>& pages );
+
+		//Gets the modification time of a file, 0 if it doesn't exist
+		static long getModifiedTime( std::string path );
+
+		//The queued images
+		std::vector<LAtlasImage> mImages;
+
+		//The packed pages
+		std::vector<LTexture*> mPages;
+};
+
+//Advances count particles by dt frames and sets the bit in dead of every particle whose life ran out
+typedef void (*ParticleKernel)( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt );
+
+//A particle as the render thread sees it
+struct ParticleSprite
+{
+	//Offsets
+	int x, y;
+
+	//Particle image and whether the shimmer shows
+	Uint8 type;
+	bool shimmer;
+};
+
+//Every particle in the scene, stored as one array per attribute and updated by a pool of worker threads
+class ParticleSystem
 {
 	public:
-		//Initialize position and animation
-		Particle( int x, int y );
+		//Particles die after this frame of animation
+		static const int PARTICLE_LIFETIME = 10;
 
-		//Shows the particle
+		//Most worker threads the particles are split across
+		static const int MAX_WORKERS = 8;
+
+		//Initializes variables and picks the particle kernel
+		ParticleSystem();
+
+		//Stops the workers
+		~ParticleSystem();
+
+		//Adds an emitter that keeps the given number of particles alive and returns its id, emitters are added before start
+		int addEmitter( int particleCount );
+
+		//Starts the workers, particles update on the calling thread if they can't be started
+		void start();
+
+		//Moves an emitter, its new particles spawn around it
+		void setEmitterPosition( int emitter, int x, int y );
+
+		//Publishes the last finished step and starts the next one dt frames later without waiting for it
+		void update( float dt );
+
+		//Shows the last published particles
 		void render();
 
-		//Checks if particle is dead
-		bool isDead();
+		//Gets number of particles in the last published step
+		int getCount();
+
+		//Stops the workers
+		void stop();
 
 	private:
-		//Offsets
-		int mPosX, mPosY;
+		//A source of particles, usually attached to an entity
+		struct Emitter
+		{
+			//Offsets set by the render thread and offsets the running step spawns around
+			int x, y;
+			int spawnX, spawnY;
+
+			//Particles to keep alive and particles alive
+			int particleCount;
+			int aliveCount;
+
+			//Where the emitter's particles and death bits start
+			int first;
+			int firstDeadWord;
 
-		//Current frame of animation
-		int mFrame;
+			//Random state, so workers don't share rand()
+			Uint32 seed;
+		};
 
-		//Type of particle
-		LTexture *mTexture;
+		//A worker thread and the emitters it updates
+		struct Worker
+		{
+			ParticleSystem* system;
+			int firstEmitter, lastEmitter;
+			SDL_Thread* thread;
+		};
+
+		//Worker thread entry point
+		static int workerThread( void* data );
+
+		//Runs steps on a worker's emitters until the workers stop
+		void runWorker( Worker* worker );
+
+		//Takes the emitter positions and time for the next step
+		void startStep();
+
+		//Updates a range of emitters and writes their particles to the back snapshot
+		void step( int firstEmitter, int lastEmitter );
+
+		//Spawns a particle around an emitter
+		void spawn( int emitter );
+
+		//Removes an emitter's particle by moving its last live particle into its place
+		void remove( int emitter, int particle );
+
+		//Gets a random number from 0 to 32767
+		static int nextRandom( Uint32& seed );
+
+		//The emitters
+		std::vector<Emitter> mEmitters;
+
+		//Particle attributes, each emitter's live particles are packed at the front of its range
+		std::vector<float> mPosX;
+		std::vector<float> mPosY;
+		std::vector<float> mVelX;
+		std::vector<float> mVelY;
+		std::vector<float> mLife;
+		std::vector<Sint32> mFrame;
+		std::vector<Uint8> mType;
+
+		//One bit per particle, set by the kernel when the particle dies
+		std::vector<Uint32> mDead;
+
+		//The update kernel for this CPU
+		ParticleKernel mKernel;
+
+		//Two snapshots of every emitter's particles, the render thread shows the front one while the workers write the back one
+		std::vector<ParticleSprite> mSnapshots[ 2 ];
+		std::vector<int> mSnapshotCounts[ 2 ];
+		int mFront;
+		int mBack;
+
+		//Time passed since the last step started and time the running step covers
+		float mPendingTime;
+		float mStepTime;
+
+		//The workers and what guards the step
+		Worker mWorkers[ MAX_WORKERS ];
+		int mWorkerCount;
+		SDL_mutex* mLock;
+		SDL_cond* mHasWork;
+		int mStep;
+		int mBusyWorkers;
+		bool mQuit;
 };
 
 
@@ -98,11 +367,17 @@ class Dot
 		//Maximum axis velocity of the dot
 		static const int DOT_VEL = 10;
 
-		//Initializes the variables and allocates particles
+		//Initializes the variables and adds the particle emitter
 		Dot();
 
-		//Deallocates particles
-		~Dot();
+		//Loads the dot image through the shared texture cache
+		bool loadMedia();
+
+		//Gives the dot image back to the cache
+		void free();
+
+		//Sets the dot drifting on its own from the given position
+		void wander( int x, int y, int velX, int velY );
 
 		//Takes key presses and adjusts the dot's velocity
 		void handleEvent( SDL_Event& e );
@@ -114,19 +389,37 @@ class Dot
 		void render();
 
     private:
-		//The particles
-		Particle* particles[ TOTAL_PARTICLES ];
+		//The dot image, shared with every other dot
+		LTexture mTexture;
 
-		//Shows the particles
-		void renderParticles();
+		//The emitter of the dot's particles
+		int mEmitter;
 
 		//The X and Y offsets of the dot
 		int mPosX, mPosY;
 
 		//The velocity of the dot
 		int mVelX, mVelY;
+
+		//Whether the dot bounces around by itself instead of following the keys
+		bool mWanders;
 };
 
+//Reference particle kernel
+void integrateParticlesScalar( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt );
+
+#ifdef PARTICLE_SIMD
+//Particle kernels that update 4 and 8 particles at a time
+void integrateParticlesSSE2( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt );
+PARTICLE_AVX2_TARGET void integrateParticlesAVX2( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt );
+#endif
+
+//Picks the fastest particle kernel the CPU supports
+ParticleKernel pickParticleKernel();
+
+//Times the particle kernels on a million particles and checks them against the reference kernel
+int benchParticles();
+
 //Starts up SDL and creates window
 bool init();
 
@@ -142,197 +435,1202 @@ SDL_Window* gWindow = NULL;
 //The window renderer
 SDL_Renderer* gRenderer = NULL;
 
+//Texture cache shared by all file loaded textures
+LTextureCache gTextureCache;
+
 //Scene textures
-LTexture gDotTexture;
-LTexture gRedTexture;
-LTexture gGreenTexture;
-LTexture gBlueTexture;
-LTexture gShimmerTexture;
+LTextureAtlas gParticleAtlas;
+
+//The particles of every dot
+ParticleSystem gParticles;
+
+//The dot that will be moving around on the screen
+Dot dot;
+
+//The dots drifting around by themselves
+Dot gWanderers[ TOTAL_WANDERERS ];
+
+LTexture::LTexture()
+{
+	//Initialize
+	mTexture = NULL;
+	mCacheEntry = NULL;
+	mWidth = 0;
+	mHeight = 0;
+}
+
+LTexture::~LTexture()
+{
+	//Deallocate
+	free();
+}
+
+LTextureCache::~LTextureCache()
+{
+	//Deallocate
+	clear();
+}
+
+LCachedTexture* LTextureCache::acquire( std::string path, bool colorKey, Uint8 keyRed, Uint8 keyGreen, Uint8 keyBlue )
+{
+	//Look for the texture in the cache
+	std::string key = makeKey( path, colorKey, keyRed, keyGreen, keyBlue );
+	std::map<std::string, LCachedTexture*>::iterator it = mEntries.find( key );
+	if( it != mEntries.end() )
+	{
+		//Share the resident texture
+		it->second->refCount++;
+		return it->second;
+	}
+
+	//The new cache entry
+	LCachedTexture* entry = NULL;
+
+	//Load image at specified path
+	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
+	if( loadedSurface == NULL )
+	{
+		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
+	}
+	else
+	{
+		//Color key image
+		if( colorKey )
+		{
+			SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, keyRed, keyGreen, keyBlue ) );
+		}
+
+		//Create texture from surface pixels
+        SDL_Texture* newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
+		if( newTexture == NULL )
+		{
+			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		}
+		else
+		{
+			//Store the texture with its first reference
+			entry = new LCachedTexture;
+			entry->key = key;
+			entry->texture = newTexture;
+			entry->width = loadedSurface->w;
+			entry->height = loadedSurface->h;
+			entry->refCount = 1;
+			mEntries[ key ] = entry;
+		}
+
+		//Get rid of old loaded surface
+		SDL_FreeSurface( loadedSurface );
+	}
+
+	return entry;
+}
+
+void LTextureCache::release( LCachedTexture* entry )
+{
+	//Drop the reference
+	if( entry != NULL && --entry->refCount <= 0 )
+	{
+		//Nobody uses the texture anymore
+		mEntries.erase( entry->key );
+		SDL_DestroyTexture( entry->texture );
+		delete entry;
+	}
+}
+
+void LTextureCache::clear()
+{
+	//Free the resident textures that are no longer held
+	std::map<std::string, LCachedTexture*>::iterator it = mEntries.begin();
+	while( it != mEntries.end() )
+	{
+		if( it->second->refCount > 0 )
+		{
+			//Leave the texture to its holders, the last release frees it
+			printf( "Warning: %s is still in use!\n", it->first.c_str() );
+			++it;
+		}
+		else
+		{
+			SDL_DestroyTexture( it->second->texture );
+			delete it->second;
+			mEntries.erase( it++ );
+		}
+	}
+}
+
+int LTextureCache::getSize()
+{
+	return mEntries.size();
+}
+
+std::string LTextureCache::makeKey( std::string path, bool colorKey, Uint8 keyRed, Uint8 keyGreen, Uint8 keyBlue )
+{
+	//Path followed by the color key settings, or no key
+	char keySuffix[ 16 ] = "|none";
+	if( colorKey )
+	{
+		sprintf( keySuffix, "|%02X%02X%02X", keyRed, keyGreen, keyBlue );
+	}
+
+	return path + keySuffix;
+}
+
+bool LTexture::loadFromFile( std::string path, bool colorKey, Uint8 keyRed, Uint8 keyGreen, Uint8 keyBlue )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//Get the shared texture
+	mCacheEntry = gTextureCache.acquire( path, colorKey, keyRed, keyGreen, keyBlue );
+	if( mCacheEntry != NULL )
+	{
+		//Get image dimensions
+		mTexture = mCacheEntry->texture;
+		mWidth = mCacheEntry->width;
+		mHeight = mCacheEntry->height;
+	}
+
+	//Return success
+	return mTexture != NULL;
+}
+
+bool LTexture::loadFromSurface( SDL_Surface* surface )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//Create texture from surface pixels
+	mTexture = SDL_CreateTextureFromSurface( gRenderer, surface );
+	if( mTexture == NULL )
+	{
+		printf( "Unable to create texture from surface! SDL Error: %s\n", SDL_GetError() );
+	}
+	else
+	{
+		//Get image dimensions
+		mWidth = surface->w;
+		mHeight = surface->h;
+	}
+
+	//Return success
+	return mTexture != NULL;
+}
+
+#ifdef _SDL_TTF_H
+bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//Render text surface
+	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
+	if( textSurface != NULL )
+	{
+		//Create texture from surface pixels
+        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+		if( mTexture == NULL )
+		{
+			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Get image dimensions
+			mWidth = textSurface->w;
+			mHeight = textSurface->h;
+		}
+
+		//Get rid of old surface
+		SDL_FreeSurface( textSurface );
+	}
+	else
+	{
+		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+	}
+
+	
+	//Return success
+	return mTexture != NULL;
+}
+#endif
+
+void LTexture::free()
+{
+	//Free texture if it exists
+	if( mTexture != NULL )
+	{
+		//Give back shared textures, destroy owned ones
+		if( mCacheEntry != NULL )
+		{
+			gTextureCache.release( mCacheEntry );
+			mCacheEntry = NULL;
+		}
+		else
+		{
+			SDL_DestroyTexture( mTexture );
+		}
+		mTexture = NULL;
+		mWidth = 0;
+		mHeight = 0;
+	}
+}
+
+void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
+{
+	//Modulate texture rgb
+	SDL_SetTextureColorMod( mTexture, red, green, blue );
+}
+
+void LTexture::setBlendMode( SDL_BlendMode blending )
+{
+	//Set blending function
+	SDL_SetTextureBlendMode( mTexture, blending );
+}
+		
+void LTexture::setAlpha( Uint8 alpha )
+{
+	//Modulate texture alpha
+	SDL_SetTextureAlphaMod( mTexture, alpha );
+}
+
+void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
+{
+	//Set rendering space and render to screen
+	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
+
+	//Set clip rendering dimensions
+	if( clip != NULL )
+	{
+		renderQuad.w = clip->w;
+		renderQuad.h = clip->h;
+	}
+
+	//Render to screen
+	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
+}
+
+int LTexture::getWidth()
+{
+	return mWidth;
+}
+
+int LTexture::getHeight()
+{
+	return mHeight;
+}
+
+LTextureAtlas::LTextureAtlas()
+{
+}
+
+LTextureAtlas::~LTextureAtlas()
+{
+	//Deallocate
+	free();
+}
+
+int LTextureAtlas::addImage( std::string path )
+{
+	//Queue the image, it is placed when the atlas is built
+	LAtlasImage image;
+	image.path = path;
+	image.page = -1;
+	image.clip.x = 0;
+	image.clip.y = 0;
+	image.clip.w = 0;
+	image.clip.h = 0;
+	mImages.push_back( image );
+
+	return mImages.size() - 1;
+}
+
+bool LTextureAtlas::build( int pageWidth, int pageHeight, std::string cachePath )
+{
+	//Get rid of preexisting pages
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		delete mPages[ i ];
+	}
+	mPages.clear();
+
+	//Use the cached pages if they're still valid
+	if( cachePath != "" && loadCache( pageWidth, pageHeight, cachePath ) )
+	{
+		return true;
+	}
+
+	//Success flag
+	bool success = true;
+
+	//Load the images with the cyan color key
+	std::vector<SDL_Surface*> surfaces( mImages.size(), (SDL_Surface*)NULL );
+	for( int i = 0; i < (int)mImages.size(); ++i )
+	{
+		surfaces[ i ] = IMG_Load( mImages[ i ].path.c_str() );
+		if( surfaces[ i ] == NULL )
+		{
+			printf( "Unable to load image %s! SDL_image Error: %s\n", mImages[ i ].path.c_str(), IMG_GetError() );
+			success = false;
+		}
+		else
+		{
+			SDL_SetColorKey( surfaces[ i ], SDL_TRUE, SDL_MapRGB( surfaces[ i ]->format, 0, 0xFF, 0xFF ) );
+			SDL_SetSurfaceBlendMode( surfaces[ i ], SDL_BLENDMODE_NONE );
+		}
+	}
+
+	//Pack tallest images first, which keeps the skyline flat
+	std::vector<int> order;
+	for( int i = 0; success && i < (int)mImages.size(); ++i )
+	{
+		order.push_back( i );
+	}
+	std::stable_sort( order.begin(), order.end(), [ &surfaces ]( int a, int b ) { return surfaces[ a ]->h > surfaces[ b ]->h; } );
+
+	//The page surfaces and their outlines
+	std::vector<SDL_Surface*> pages;
+	std::vector< std::vector<SkylineNode> > skylines;
+
+	for( int i = 0; i < (int)order.size(); ++i )
+	{
+		//Leave a pixel of padding so linear filtering doesn't bleed between images
+		SDL_Surface* surface = surfaces[ order[ i ] ];
+		int paddedWidth = surface->w + 1;
+		int paddedHeight = surface->h + 1;
+
+		//Find a page with room for the image
+		int page = 0, node = -1, x = 0, y = 0;
+		for( ; page < (int)pages.size(); ++page )
+		{
+			node = findPosition( skylines[ page ], pageWidth, pageHeight, paddedWidth, paddedHeight, x, y );
+			if( node != -1 )
+			{
+				break;
+			}
+		}
+
+		//Start a new page
+		if( node == -1 )
+		{
+			SDL_Surface* newPage = SDL_CreateRGBSurfaceWithFormat( 0, pageWidth, pageHeight, 32, SDL_PIXELFORMAT_RGBA32 );
+			if( newPage == NULL )
+			{
+				printf( "Unable to create atlas page! SDL Error: %s\n", SDL_GetError() );
+				success = false;
+				break;
+			}
+			SDL_FillRect( newPage, NULL, SDL_MapRGBA( newPage->format, 0, 0, 0, 0 ) );
+			pages.push_back( newPage );
+
+			std::vector<SkylineNode> skyline;
+			SkylineNode ground = { 0, 0, pageWidth };
+			skyline.push_back( ground );
+			skylines.push_back( skyline );
+
+			page = pages.size() - 1;
+			node = findPosition( skylines[ page ], pageWidth, pageHeight, paddedWidth, paddedHeight, x, y );
+			if( node == -1 )
+			{
+				printf( "Image %s doesn't fit on a %dx%d atlas page!\n", mImages[ order[ i ] ].path.c_str(), pageWidth, pageHeight );
+				success = false;
+				break;
+			}
+		}
+
+		//Place the image
+		addRect( skylines[ page ], node, x, y, paddedWidth, paddedHeight );
+		LAtlasImage& image = mImages[ order[ i ] ];
+		image.page = page;
+		image.clip.x = x;
+		image.clip.y = y;
+		image.clip.w = surface->w;
+		image.clip.h = surface->h;
+
+		//Copy the pixels, color keyed pixels stay transparent
+		SDL_Rect destination = image.clip;
+		SDL_BlitSurface( surface, NULL, pages[ page ], &destination );
+	}
+
+	//Upload the pages
+	for( int i = 0; success && i < (int)pages.size(); ++i )
+	{
+		LTexture* pageTexture = new LTexture;
+		if( !pageTexture->loadFromSurface( pages[ i ] ) )
+		{
+			success = false;
+		}
+		mPages.push_back( pageTexture );
+	}
+
+	//Save the pages so the next startup skips packing
+	if( success && cachePath != "" )
+	{
+		saveCache( pageWidth, pageHeight, cachePath, pages );
+	}
+
+	//Get rid of the loaded surfaces
+	for( int i = 0; i < (int)surfaces.size(); ++i )
+	{
+		SDL_FreeSurface( surfaces[ i ] );
+	}
+	for( int i = 0; i < (int)pages.size(); ++i )
+	{
+		SDL_FreeSurface( pages[ i ] );
+	}
+
+	return success;
+}
+
+LTexture* LTextureAtlas::getTexture( int image )
+{
+	return mPages[ mImages[ image ].page ];
+}
+
+LTexture* LTextureAtlas::getPage( int page )
+{
+	return mPages[ page ];
+}
+
+SDL_Rect* LTextureAtlas::getClip( int image )
+{
+	return &mImages[ image ].clip;
+}
+
+int LTextureAtlas::getPageCount()
+{
+	return mPages.size();
+}
+
+void LTextureAtlas::free()
+{
+	//Free pages
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		delete mPages[ i ];
+	}
+	mPages.clear();
+	mImages.clear();
+}
+
+int LTextureAtlas::findPosition( std::vector<SkylineNode>& skyline, int pageWidth, int pageHeight, int width, int height, int& x, int& y )
+{
+	//The best fit so far
+	int bestNode = -1;
+	int bestY = pageHeight;
+
+	//Try the rectangle's left edge at the start of each skyline segment
+	for( int i = 0; i < (int)skyline.size(); ++i )
+	{
+		//The rectangle must not stick out of the page on the right
+		int left = skyline[ i ].x;
+		if( left + width > pageWidth )
+		{
+			break;
+		}
+
+		//Rest the rectangle on the highest segment beneath it
+		int top = 0;
+		int covered = 0;
+		for( int j = i; covered < width; ++j )
+		{
+			if( skyline[ j ].y > top )
+			{
+				top = skyline[ j ].y;
+			}
+			covered += skyline[ j ].width;
+		}
+
+		//Keep the position closest to the top of the page
+		if( top + height <= pageHeight && top < bestY )
+		{
+			bestNode = i;
+			bestY = top;
+			x = left;
+			y = top;
+		}
+	}
+
+	return bestNode;
+}
+
+void LTextureAtlas::addRect( std::vector<SkylineNode>& skyline, int node, int x, int y, int width, int height )
+{
+	//The new segment on top of the rectangle
+	SkylineNode top = { x, y + height, width };
+	skyline.insert( skyline.begin() + node, top );
+
+	//Cut the segments the rectangle now covers
+	for( int i = node + 1; i < (int)skyline.size(); )
+	{
+		int coveredEnd = x + width;
+		if( skyline[ i ].x >= coveredEnd )
+		{
+			break;
+		}
+
+		//Shrink a partially covered segment
+		int shrink = coveredEnd - skyline[ i ].x;
+		if( skyline[ i ].width > shrink )
+		{
+			skyline[ i ].x += shrink;
+			skyline[ i ].width -= shrink;
+			break;
+		}
+
+		//Remove a fully covered segment
+		skyline.erase( skyline.begin() + i );
+	}
+
+	//Merge neighboring segments at the same height
+	for( int i = 0; i + 1 < (int)skyline.size(); )
+	{
+		if( skyline[ i ].y == skyline[ i + 1 ].y )
+		{
+			skyline[ i ].width += skyline[ i + 1 ].width;
+			skyline.erase( skyline.begin() + i + 1 );
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+bool LTextureAtlas::loadCache( int pageWidth, int pageHeight, std::string cachePath )
+{
+	//Open the layout
+	std::ifstream layout( cachePath.c_str() );
+	if( !layout )
+	{
+		return false;
+	}
+
+	//The cache must be for the same page size and image count
+	int cachedWidth = 0, cachedHeight = 0, pageCount = 0, imageCount = 0;
+	layout >> cachedWidth >> cachedHeight >> pageCount >> imageCount;
+	if( layout.fail() || cachedWidth != pageWidth || cachedHeight != pageHeight || imageCount != (int)mImages.size() )
+	{
+		return false;
+	}
+
+	//Read the placement of each image
+	std::vector<LAtlasImage> images = mImages;
+	for( int i = 0; i < imageCount; ++i )
+	{
+		std::string path;
+		long modified = 0;
+		LAtlasImage& image = images[ i ];
+		layout >> path >> modified >> image.page >> image.clip.x >> image.clip.y >> image.clip.w >> image.clip.h;
+
+		//The image must be the same file, unchanged since packing
+		if( layout.fail() || path != image.path || modified != getModifiedTime( path ) || image.page < 0 || image.page >= pageCount )
+		{
+			return false;
+		}
+	}
+
+	//Load the pages
+	for( int i = 0; i < pageCount; ++i )
+	{
+		char pagePath[ 16 ];
+		sprintf( pagePath, ".%d.png", i );
+
+		SDL_Surface* pageSurface = IMG_Load( ( cachePath + pagePath ).c_str() );
+		LTexture* pageTexture = new LTexture;
+		mPages.push_back( pageTexture );
+		if( pageSurface != NULL )
+		{
+			pageTexture->loadFromSurface( pageSurface );
+			SDL_FreeSurface( pageSurface );
+		}
+	}
+
+	//Throw away partially loaded caches
+	for( int i = 0; i < (int)mPages.size(); ++i )
+	{
+		if( mPages[ i ]->getWidth() == 0 )
+		{
+			for( int j = 0; j < (int)mPages.size(); ++j )
+			{
+				delete mPages[ j ];
+			}
+			mPages.clear();
+			return false;
+		}
+	}
+
+	//Use the cached layout
+	mImages = images;
+	return true;
+}
+
+void LTextureAtlas::saveCache( int pageWidth, int pageHeight, std::string cachePath, std::vector<SDL_Surface*>& pages )
+{
+	//Save the page images
+	for( int i = 0; i < (int)pages.size(); ++i )
+	{
+		char pagePath[ 16 ];
+		sprintf( pagePath, ".%d.png", i );
+
+		if( IMG_SavePNG( pages[ i ], ( cachePath + pagePath ).c_str() ) != 0 )
+		{
+			printf( "Unable to save atlas page! SDL_image Error: %s\n", IMG_GetError() );
+			return;
+		}
+	}
+
+	//Save the layout
+	std::ofstream layout( cachePath.c_str() );
+	if( !layout )
+	{
+		printf( "Unable to save atlas layout %s!\n", cachePath.c_str() );
+		return;
+	}
+
+	layout << pageWidth << " " << pageHeight << " " << pages.size() << " " << mImages.size() << "\n";
+	for( int i = 0; i < (int)mImages.size(); ++i )
+	{
+		LAtlasImage& image = mImages[ i ];
+		layout << image.path << " " << getModifiedTime( image.path ) << " " << image.page << " ";
+		layout << image.clip.x << " " << image.clip.y << " " << image.clip.w << " " << image.clip.h << "\n";
+	}
+}
+
+long LTextureAtlas::getModifiedTime( std::string path )
+{
+	//Get the file's info
+	struct stat info;
+	if( stat( path.c_str(), &info ) != 0 )
+	{
+		return 0;
+	}
+
+	return (long)info.st_mtime;
+}
+
+ParticleSystem::ParticleSystem()
+{
+	//Initialize
+	mKernel = pickParticleKernel();
+	mFront = 0;
+	mBack = 0;
+	mPendingTime = 0.f;
+	mStepTime = 0.f;
+	mWorkerCount = 0;
+	mLock = NULL;
+	mHasWork = NULL;
+	mStep = 0;
+	mBusyWorkers = 0;
+	mQuit = false;
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	//Stop the workers
+	stop();
+}
+
+int ParticleSystem::addEmitter( int particleCount )
+{
+	//Add the emitter after the ranges of the others
+	Emitter emitter;
+	emitter.x = 0;
+	emitter.y = 0;
+	emitter.spawnX = 0;
+	emitter.spawnY = 0;
+	emitter.particleCount = particleCount;
+	emitter.aliveCount = 0;
+	emitter.first = mPosX.size();
+	emitter.firstDeadWord = mDead.size();
+	emitter.seed = rand();
+	mEmitters.push_back( emitter );
+
+	//Make room for its particles up front so spawning never allocates
+	int capacity = mPosX.size() + particleCount;
+	mPosX.resize( capacity );
+	mPosY.resize( capacity );
+	mVelX.resize( capacity );
+	mVelY.resize( capacity );
+	mLife.resize( capacity );
+	mFrame.resize( capacity );
+	mType.resize( capacity );
+	mDead.resize( mDead.size() + ( particleCount + 31 ) / 32 );
+	for( int i = 0; i < 2; ++i )
+	{
+		mSnapshots[ i ].resize( capacity );
+		mSnapshotCounts[ i ].push_back( 0 );
+	}
+
+	return mEmitters.size() - 1;
+}
+
+void ParticleSystem::start()
+{
+	//Leave a core for the render thread and give every worker at least one emitter
+	int workerCount = SDL_min( SDL_max( SDL_GetCPUCount() - 1, 1 ), MAX_WORKERS );
+	workerCount = SDL_min( workerCount, (int)mEmitters.size() );
+	if( workerCount == 0 )
+	{
+		return;
+	}
+
+	mLock = SDL_CreateMutex();
+	mHasWork = SDL_CreateCond();
+	mQuit = false;
+	mStep = 0;
+	mBusyWorkers = 0;
+
+	//Split the emitters evenly across the workers
+	for( int i = 0; i < workerCount; ++i )
+	{
+		Worker& worker = mWorkers[ i ];
+		worker.system = this;
+		worker.firstEmitter = mEmitters.size() * i / workerCount;
+		worker.lastEmitter = mEmitters.size() * ( i + 1 ) / workerCount;
+		worker.thread = SDL_CreateThread( workerThread, "ParticleWorker", &worker );
+		if( worker.thread == NULL )
+		{
+			printf( "Unable to create particle worker, particles update on the render thread! SDL Error: %s\n", SDL_GetError() );
+			stop();
+			return;
+		}
+		mWorkerCount = i + 1;
+	}
+}
 
-LTexture::LTexture()
+void ParticleSystem::setEmitterPosition( int emitter, int x, int y )
 {
-	//Initialize
-	mTexture = NULL;
-	mWidth = 0;
-	mHeight = 0;
+	mEmitters[ emitter ].x = x;
+	mEmitters[ emitter ].y = y;
 }
 
-LTexture::~LTexture()
+void ParticleSystem::update( float dt )
 {
-	//Deallocate
-	free();
+	mPendingTime += dt;
+
+	//Without workers run the step here and show it right away
+	if( mWorkerCount == 0 )
+	{
+		startStep();
+		step( 0, mEmitters.size() );
+		mFront = mBack;
+		return;
+	}
+
+	//If the workers are done publish their step and start the next one, otherwise keep showing the last one
+	SDL_LockMutex( mLock );
+	if( mBusyWorkers == 0 )
+	{
+		mFront = mBack;
+		startStep();
+		mStep++;
+		mBusyWorkers = mWorkerCount;
+		SDL_CondBroadcast( mHasWork );
+	}
+	SDL_UnlockMutex( mLock );
 }
 
-bool LTexture::loadFromFile( std::string path )
+void ParticleSystem::render()
 {
-	//Get rid of preexisting texture
-	free();
+	//Show the front snapshot
+	std::vector<ParticleSprite>& sprites = mSnapshots[ mFront ];
+	std::vector<int>& counts = mSnapshotCounts[ mFront ];
+	LTexture* shimmerTexture = gParticleAtlas.getTexture( PARTICLE_SHIMMER );
+	SDL_Rect* shimmerClip = gParticleAtlas.getClip( PARTICLE_SHIMMER );
+	for( int emitter = 0; emitter < (int)mEmitters.size(); ++emitter )
+	{
+		int first = mEmitters[ emitter ].first;
+		for( int i = first; i < first + counts[ emitter ]; ++i )
+		{
+			//Show image
+			gParticleAtlas.getTexture( sprites[ i ].type )->render( sprites[ i ].x, sprites[ i ].y, gParticleAtlas.getClip( sprites[ i ].type ) );
 
-	//The final texture
-	SDL_Texture* newTexture = NULL;
+			//Show shimmer
+			if( sprites[ i ].shimmer )
+			{
+				shimmerTexture->render( sprites[ i ].x, sprites[ i ].y, shimmerClip );
+			}
+		}
+	}
+}
 
-	//Load image at specified path
-	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
-	if( loadedSurface == NULL )
+int ParticleSystem::getCount()
+{
+	int count = 0;
+	for( int emitter = 0; emitter < (int)mEmitters.size(); ++emitter )
 	{
-		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
+		count += mSnapshotCounts[ mFront ][ emitter ];
 	}
-	else
+	return count;
+}
+
+void ParticleSystem::stop()
+{
+	//Stop the workers
+	if( mLock != NULL )
 	{
-		//Color key image
-		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
+		SDL_LockMutex( mLock );
+		mQuit = true;
+		SDL_CondBroadcast( mHasWork );
+		SDL_UnlockMutex( mLock );
 
-		//Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
-		if( newTexture == NULL )
-		{
-			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
-		}
-		else
+		for( int i = 0; i < mWorkerCount; ++i )
 		{
-			//Get image dimensions
-			mWidth = loadedSurface->w;
-			mHeight = loadedSurface->h;
+			SDL_WaitThread( mWorkers[ i ].thread, NULL );
+			mWorkers[ i ].thread = NULL;
 		}
+		mWorkerCount = 0;
 
-		//Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
+		SDL_DestroyMutex( mLock );
+		mLock = NULL;
+	}
+	if( mHasWork != NULL )
+	{
+		SDL_DestroyCond( mHasWork );
+		mHasWork = NULL;
 	}
+}
 
-	//Return success
-	mTexture = newTexture;
-	return mTexture != NULL;
+int ParticleSystem::workerThread( void* data )
+{
+	//Run the worker passed in
+	Worker* worker = (Worker*)data;
+	worker->system->runWorker( worker );
+	return 0;
 }
 
-#ifdef _SDL_TTF_H
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
+void ParticleSystem::runWorker( Worker* worker )
 {
-	//Get rid of preexisting texture
-	free();
+	//The last step this worker ran
+	int lastStep = 0;
 
-	//Render text surface
-	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
-	if( textSurface != NULL )
+	SDL_LockMutex( mLock );
+	while( !mQuit )
 	{
-		//Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if( mTexture == NULL )
-		{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else
+		//Wait for the next step
+		if( mStep == lastStep )
 		{
-			//Get image dimensions
-			mWidth = textSurface->w;
-			mHeight = textSurface->h;
+			SDL_CondWait( mHasWork, mLock );
+			continue;
 		}
+		lastStep = mStep;
 
-		//Get rid of old surface
-		SDL_FreeSurface( textSurface );
+		//Update without holding the lock
+		SDL_UnlockMutex( mLock );
+		step( worker->firstEmitter, worker->lastEmitter );
+		SDL_LockMutex( mLock );
+
+		//Tell the render thread once every worker is done
+		mBusyWorkers--;
 	}
-	else
+	SDL_UnlockMutex( mLock );
+}
+
+void ParticleSystem::startStep()
+{
+	//Spawn around where the emitters are now
+	for( int emitter = 0; emitter < (int)mEmitters.size(); ++emitter )
 	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+		mEmitters[ emitter ].spawnX = mEmitters[ emitter ].x;
+		mEmitters[ emitter ].spawnY = mEmitters[ emitter ].y;
 	}
 
-	
-	//Return success
-	return mTexture != NULL;
+	//Write to the snapshot that isn't shown and cover all the time since the last step
+	mBack = 1 - mFront;
+	mStepTime = mPendingTime;
+	mPendingTime = 0.f;
 }
-#endif
 
-void LTexture::free()
+void ParticleSystem::step( int firstEmitter, int lastEmitter )
 {
-	//Free texture if it exists
-	if( mTexture != NULL )
+	for( int emitter = firstEmitter; emitter < lastEmitter; ++emitter )
 	{
-		SDL_DestroyTexture( mTexture );
-		mTexture = NULL;
-		mWidth = 0;
-		mHeight = 0;
+		Emitter& source = mEmitters[ emitter ];
+		int first = source.first;
+
+		if( source.aliveCount > 0 )
+		{
+			//Move, animate and age the emitter's particles
+			mKernel( &mPosX[ first ], &mPosY[ first ], &mVelX[ first ], &mVelY[ first ], &mLife[ first ], &mFrame[ first ], &mDead[ source.firstDeadWord ], source.aliveCount, mStepTime );
+
+			//Remove dead particles from the back so every hole is filled by a live particle
+			for( int word = ( source.aliveCount - 1 ) / 32; word >= 0; --word )
+			{
+				Uint32 bits = mDead[ source.firstDeadWord + word ];
+				for( int bit = 31; bits != 0; --bit )
+				{
+					if( bits & ( 1u << bit ) )
+					{
+						remove( emitter, first + word * 32 + bit );
+						bits &= ~( 1u << bit );
+					}
+				}
+			}
+		}
+
+		//Replace dead particles
+		while( source.aliveCount < source.particleCount )
+		{
+			spawn( emitter );
+		}
+
+		//Copy what the render thread needs to the back snapshot
+		std::vector<ParticleSprite>& sprites = mSnapshots[ mBack ];
+		for( int i = first; i < first + source.aliveCount; ++i )
+		{
+			sprites[ i ].x = (int)mPosX[ i ];
+			sprites[ i ].y = (int)mPosY[ i ];
+			sprites[ i ].type = mType[ i ];
+			sprites[ i ].shimmer = mFrame[ i ] % 2 == 0;
+		}
+		mSnapshotCounts[ mBack ][ emitter ] = source.aliveCount;
 	}
 }
 
-void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
+void ParticleSystem::spawn( int emitter )
 {
-	//Modulate texture rgb
-	SDL_SetTextureColorMod( mTexture, red, green, blue );
+	//Take the emitter's next free slot
+	Emitter& source = mEmitters[ emitter ];
+	int i = source.first + source.aliveCount++;
+
+	//Set offsets
+	mPosX[ i ] = (float)( source.spawnX - 5 + ( nextRandom( source.seed ) % 25 ) );
+	mPosY[ i ] = (float)( source.spawnY - 5 + ( nextRandom( source.seed ) % 25 ) );
+
+	//Drift slowly away from the emitter
+	mVelX[ i ] = ( nextRandom( source.seed ) % 11 - 5 ) / 10.f;
+	mVelY[ i ] = ( nextRandom( source.seed ) % 11 - 5 ) / 10.f;
+
+	//Initialize animation and live until the frame passes the lifetime
+	mFrame[ i ] = nextRandom( source.seed ) % 5;
+	mLife[ i ] = (float)( PARTICLE_LIFETIME + 1 - mFrame[ i ] );
+
+	//Set type
+	switch( nextRandom( source.seed ) % 3 )
+	{
+		case 0: mType[ i ] = PARTICLE_RED; break;
+		case 1: mType[ i ] = PARTICLE_GREEN; break;
+		case 2: mType[ i ] = PARTICLE_BLUE; break;
+	}
 }
 
-void LTexture::setBlendMode( SDL_BlendMode blending )
+void ParticleSystem::remove( int emitter, int particle )
 {
-	//Set blending function
-	SDL_SetTextureBlendMode( mTexture, blending );
+	//Fill the hole with the emitter's last live particle
+	int last = mEmitters[ emitter ].first + --mEmitters[ emitter ].aliveCount;
+	mPosX[ particle ] = mPosX[ last ];
+	mPosY[ particle ] = mPosY[ last ];
+	mVelX[ particle ] = mVelX[ last ];
+	mVelY[ particle ] = mVelY[ last ];
+	mLife[ particle ] = mLife[ last ];
+	mFrame[ particle ] = mFrame[ last ];
+	mType[ particle ] = mType[ last ];
 }
-		
-void LTexture::setAlpha( Uint8 alpha )
+
+int ParticleSystem::nextRandom( Uint32& seed )
 {
-	//Modulate texture alpha
-	SDL_SetTextureAlphaMod( mTexture, alpha );
+	seed = seed * 1103515245 + 12345;
+	return ( seed >> 16 ) & 0x7FFF;
 }
 
-void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
+void integrateParticlesScalar( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt )
 {
-	//Set rendering space and render to screen
-	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
+	//Clear the death bits
+	memset( dead, 0, ( ( count + 31 ) / 32 ) * sizeof( Uint32 ) );
 
-	//Set clip rendering dimensions
-	if( clip != NULL )
+	for( int i = 0; i < count; ++i )
 	{
-		renderQuad.w = clip->w;
-		renderQuad.h = clip->h;
+		//Move
+		posX[ i ] += velX[ i ] * dt;
+		posY[ i ] += velY[ i ] * dt;
+
+		//Animate
+		frame[ i ]++;
+
+		//Age and mark dead particles
+		life[ i ] -= dt;
+		if( life[ i ] <= 0.f )
+		{
+			dead[ i / 32 ] |= 1u << ( i % 32 );
+		}
 	}
+}
 
-	//Render to screen
-	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
+#ifdef PARTICLE_SIMD
+void integrateParticlesSSE2( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt )
+{
+	__m128 step = _mm_set1_ps( dt );
+	__m128 zero = _mm_setzero_ps();
+	__m128i one = _mm_set1_epi32( 1 );
+
+	//Go through a word of death bits at a time, 4 particles per step
+	int i = 0;
+	for( ; i + 32 <= count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 4 )
+		{
+			int k = i + j;
+
+			//Move
+			_mm_storeu_ps( posX + k, _mm_add_ps( _mm_loadu_ps( posX + k ), _mm_mul_ps( _mm_loadu_ps( velX + k ), step ) ) );
+			_mm_storeu_ps( posY + k, _mm_add_ps( _mm_loadu_ps( posY + k ), _mm_mul_ps( _mm_loadu_ps( velY + k ), step ) ) );
+
+			//Animate
+			__m128i* frames = (__m128i*)( frame + k );
+			_mm_storeu_si128( frames, _mm_add_epi32( _mm_loadu_si128( frames ), one ) );
+
+			//Age and mark dead particles
+			__m128 age = _mm_sub_ps( _mm_loadu_ps( life + k ), step );
+			_mm_storeu_ps( life + k, age );
+			bits |= (Uint32)_mm_movemask_ps( _mm_cmple_ps( age, zero ) ) << j;
+		}
+		dead[ i / 32 ] = bits;
+	}
+
+	//Finish the last partial word with the reference kernel
+	integrateParticlesScalar( posX + i, posY + i, velX + i, velY + i, life + i, frame + i, dead + i / 32, count - i, dt );
 }
 
-int LTexture::getWidth()
+PARTICLE_AVX2_TARGET void integrateParticlesAVX2( float* posX, float* posY, const float* velX, const float* velY, float* life, Sint32* frame, Uint32* dead, int count, float dt )
 {
-	return mWidth;
+	__m256 step = _mm256_set1_ps( dt );
+	__m256 zero = _mm256_setzero_ps();
+	__m256i one = _mm256_set1_epi32( 1 );
+
+	//Go through a word of death bits at a time, 8 particles per step
+	int i = 0;
+	for( ; i + 32 <= count; i += 32 )
+	{
+		Uint32 bits = 0;
+		for( int j = 0; j < 32; j += 8 )
+		{
+			int k = i + j;
+
+			//Move
+			_mm256_storeu_ps( posX + k, _mm256_add_ps( _mm256_loadu_ps( posX + k ), _mm256_mul_ps( _mm256_loadu_ps( velX + k ), step ) ) );
+			_mm256_storeu_ps( posY + k, _mm256_add_ps( _mm256_loadu_ps( posY + k ), _mm256_mul_ps( _mm256_loadu_ps( velY + k ), step ) ) );
+
+			//Animate
+			__m256i* frames = (__m256i*)( frame + k );
+			_mm256_storeu_si256( frames, _mm256_add_epi32( _mm256_loadu_si256( frames ), one ) );
+
+			//Age and mark dead particles
+			__m256 age = _mm256_sub_ps( _mm256_loadu_ps( life + k ), step );
+			_mm256_storeu_ps( life + k, age );
+			bits |= (Uint32)_mm256_movemask_ps( _mm256_cmp_ps( age, zero, _CMP_LE_OQ ) ) << j;
+		}
+		dead[ i / 32 ] = bits;
+	}
+
+	//Finish the last partial word with the reference kernel
+	integrateParticlesScalar( posX + i, posY + i, velX + i, velY + i, life + i, frame + i, dead + i / 32, count - i, dt );
 }
+#endif
 
-int LTexture::getHeight()
+ParticleKernel pickParticleKernel()
 {
-	return mHeight;
+#ifdef PARTICLE_SIMD
+	if( SDL_HasAVX2() )
+	{
+		return integrateParticlesAVX2;
+	}
+	if( SDL_HasSSE2() )
+	{
+		return integrateParticlesSSE2;
+	}
+#endif
+	return integrateParticlesScalar;
 }
 
-Particle::Particle( int x, int y )
+int benchParticles()
 {
-    //Set offsets
-    mPosX = x - 5 + ( rand() % 25 );
-    mPosY = y - 5 + ( rand() % 25 );
+	//Benchmark size
+	const int PARTICLE_COUNT = 1000000;
+	const int BENCH_RUNS = 100;
+	const int WORDS = ( PARTICLE_COUNT + 31 ) / 32;
+
+	//Random particles every kernel starts from
+	std::vector<float> posX( PARTICLE_COUNT ), posY( PARTICLE_COUNT ), velX( PARTICLE_COUNT ), velY( PARTICLE_COUNT ), life( PARTICLE_COUNT );
+	std::vector<Sint32> frame( PARTICLE_COUNT );
+	for( int i = 0; i < PARTICLE_COUNT; ++i )
+	{
+		posX[ i ] = (float)( rand() % SCREEN_WIDTH );
+		posY[ i ] = (float)( rand() % SCREEN_HEIGHT );
+		velX[ i ] = ( rand() % 11 - 5 ) / 10.f;
+		velY[ i ] = ( rand() % 11 - 5 ) / 10.f;
+		life[ i ] = (float)( rand() % ( ParticleSystem::PARTICLE_LIFETIME + 2 ) );
+		frame[ i ] = rand() % 5;
+	}
 
-    //Initialize animation
-    mFrame = rand() % 5;
+	//One update with the reference kernel to check the others against
+	std::vector<float> refX( posX ), refY( posY ), refLife( life );
+	std::vector<Sint32> refFrame( frame );
+	std::vector<Uint32> refDead( WORDS );
+	integrateParticlesScalar( &refX[ 0 ], &refY[ 0 ], &velX[ 0 ], &velY[ 0 ], &refLife[ 0 ], &refFrame[ 0 ], &refDead[ 0 ], PARTICLE_COUNT, 1.f );
+
+	//The kernels to compare
+	const char* names[ 3 ] = { "scalar", "SSE2", "AVX2" };
+	ParticleKernel kernels[ 3 ] = { integrateParticlesScalar, NULL, NULL };
+#ifdef PARTICLE_SIMD
+	if( SDL_HasSSE2() )
+	{
+		kernels[ 1 ] = integrateParticlesSSE2;
+	}
+	if( SDL_HasAVX2() )
+	{
+		kernels[ 2 ] = integrateParticlesAVX2;
+	}
+#endif
 
-    //Set type
-    switch( rand() % 3 )
-    {
-        case 0: mTexture = &gRedTexture; break;
-        case 1: mTexture = &gGreenTexture; break;
-        case 2: mTexture = &gBlueTexture; break;
-    }
-}
+	bool success = true;
+	double scalarTime = 0.0;
+	for( int k = 0; k < 3; ++k )
+	{
+		if( kernels[ k ] == NULL )
+		{
+			printf( "%-6s  not supported\n", names[ k ] );
+			continue;
+		}
 
-void Particle::render()
-{
-    //Show image
-	mTexture->render( mPosX, mPosY );
+		//Check one update against the reference kernel
+		std::vector<float> x( posX ), y( posY ), age( life );
+		std::vector<Sint32> frames( frame );
+		std::vector<Uint32> dead( WORDS );
+		kernels[ k ]( &x[ 0 ], &y[ 0 ], &velX[ 0 ], &velY[ 0 ], &age[ 0 ], &frames[ 0 ], &dead[ 0 ], PARTICLE_COUNT, 1.f );
 
-    //Show shimmer
-    if( mFrame % 2 == 0 )
-    {
-		gShimmerTexture.render( mPosX, mPosY );
-    }
+		int mismatches = 0;
+		for( int i = 0; i < PARTICLE_COUNT; ++i )
+		{
+			if( fabsf( x[ i ] - refX[ i ] ) > 0.001f || fabsf( y[ i ] - refY[ i ] ) > 0.001f || age[ i ] != refLife[ i ] || frames[ i ] != refFrame[ i ] )
+			{
+				++mismatches;
+			}
+		}
+		if( dead != refDead )
+		{
+			++mismatches;
+		}
 
-    //Animate
-    mFrame++;
-}
+		//Time the kernel
+		Uint64 start = SDL_GetPerformanceCounter();
+		for( int run = 0; run < BENCH_RUNS; ++run )
+		{
+			kernels[ k ]( &x[ 0 ], &y[ 0 ], &velX[ 0 ], &velY[ 0 ], &age[ 0 ], &frames[ 0 ], &dead[ 0 ], PARTICLE_COUNT, 1.f );
+		}
+		double time = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / BENCH_RUNS;
+		if( k == 0 )
+		{
+			scalarTime = time;
+		}
 
-bool Particle::isDead()
-{
-    return mFrame > 10;
+		printf( "%-6s  %8.3f ms per update  %5.2fx  %s\n", names[ k ], time, scalarTime / time, mismatches == 0 ? "matches scalar" : "MISMATCH" );
+		if( mismatches != 0 )
+		{
+			success = false;
+		}
+	}
+
+	return success ? 0 : 1;
 }
 
 Dot::Dot()
@@ -345,20 +1643,38 @@ Dot::Dot()
     mVelX = 0;
     mVelY = 0;
 
-    //Initialize particles
-    for( int i = 0; i < TOTAL_PARTICLES; ++i )
-    {
-        particles[ i ] = new Particle( mPosX, mPosY );
-    }
+    //Follow the keys
+    mWanders = false;
+
+    //Add the emitter for the dot's particles
+    mEmitter = gParticles.addEmitter( TOTAL_PARTICLES );
 }
 
-Dot::~Dot()
+bool Dot::loadMedia()
 {
-    //Delete particles
-    for( int i = 0; i < TOTAL_PARTICLES; ++i )
-    {
-        delete particles[ i ];
-    }
+	//Every dot gets the same resident texture
+	return mTexture.loadFromFile( "assets/dot.bmp" );
+}
+
+void Dot::free()
+{
+	//Drop the reference to the shared texture
+	mTexture.free();
+}
+
+void Dot::wander( int x, int y, int velX, int velY )
+{
+	//Start at the given position
+	mPosX = x;
+	mPosY = y;
+
+	//Keep moving until the next wall
+	mVelX = velX;
+	mVelY = velY;
+	mWanders = true;
+
+	//Start the particles around the dot
+	gParticles.setEmitterPosition( mEmitter, mPosX, mPosY );
 }
 
 void Dot::handleEvent( SDL_Event& e )
@@ -399,6 +1715,12 @@ void Dot::move()
     {
         //Move back
         mPosX -= mVelX;
+
+        //Drifting dots bounce off the wall
+        if( mWanders )
+        {
+            mVelX = -mVelX;
+        }
     }
 
     //Move the dot up or down
@@ -409,36 +1731,22 @@ void Dot::move()
     {
         //Move back
         mPosY -= mVelY;
+
+        //Drifting dots bounce off the wall
+        if( mWanders )
+        {
+            mVelY = -mVelY;
+        }
     }
+
+    //Keep the particles around the dot
+    gParticles.setEmitterPosition( mEmitter, mPosX, mPosY );
 }
 
 void Dot::render()
 {
     //Show the dot
-	gDotTexture.render( mPosX, mPosY );
-
-	//Show particles on top of dot
-	renderParticles();
-}
-
-void Dot::renderParticles()
-{
-	//Go through particles
-    for( int i = 0; i < TOTAL_PARTICLES; ++i )
-    {
-        //Delete and replace dead particles
-        if( particles[ i ]->isDead() )
-        {
-            delete particles[ i ];
-            particles[ i ] = new Particle( mPosX, mPosY );
-        }
-    }
-
-    //Show particles
-    for( int i = 0; i < TOTAL_PARTICLES; ++i )
-    {
-        particles[ i ]->render();
-    }
+	mTexture.render( mPosX, mPosY );
 }
 
 bool init()
@@ -509,57 +1817,58 @@ bool loadMedia()
 	bool success = true;
 
 	//Load dot texture
-	if( !gDotTexture.loadFromFile( "assets/dot.bmp" ) )
+	if( !dot.loadMedia() )
 	{
 		printf( "Failed to load dot texture!\n" );
 		success = false;
 	}
 
-	//Load red texture
-	if( !gRedTexture.loadFromFile( "assets/red.bmp" ) )
+	//Spread the drifting dots over the screen, they reuse the dot texture instead of loading it again
+	for( int i = 0; i < TOTAL_WANDERERS; ++i )
 	{
-		printf( "Failed to load red texture!\n" );
-		success = false;
-	}
-
-	//Load green texture
-	if( !gGreenTexture.loadFromFile( "assets/green.bmp" ) )
-	{
-		printf( "Failed to load green texture!\n" );
-		success = false;
+		gWanderers[ i ].wander( ( i + 1 ) * SCREEN_WIDTH / ( TOTAL_WANDERERS + 1 ), SCREEN_HEIGHT / 4 + ( i % 3 ) * SCREEN_HEIGHT / 4, i % 2 == 0 ? 3 : -3, 1 + i % 3 );
+		if( !gWanderers[ i ].loadMedia() )
+		{
+			printf( "Failed to load dot texture!\n" );
+			success = false;
+		}
 	}
 
-	//Load blue texture
-	if( !gBlueTexture.loadFromFile( "assets/blue.bmp" ) )
+	//Pack the particle images into one page, in PARTICLE_* order
+	gParticleAtlas.addImage( "assets/red.bmp" );
+	gParticleAtlas.addImage( "assets/green.bmp" );
+	gParticleAtlas.addImage( "assets/blue.bmp" );
+	gParticleAtlas.addImage( "assets/shimmer.bmp" );
+	if( !gParticleAtlas.build( 256, 256, "assets/particles.atlas" ) )
 	{
-		printf( "Failed to load blue texture!\n" );
+		printf( "Failed to build particle atlas!\n" );
 		success = false;
 	}
-
-	//Load shimmer texture
-	if( !gShimmerTexture.loadFromFile( "assets/shimmer.bmp" ) )
+	else
 	{
-		printf( "Failed to load shimmer texture!\n" );
-		success = false;
+		//Set texture transparency
+		for( int i = 0; i < gParticleAtlas.getPageCount(); ++i )
+		{
+			gParticleAtlas.getPage( i )->setAlpha( 192 );
+		}
 	}
-	
-	//Set texture transparency
-	gRedTexture.setAlpha( 192 );
-	gGreenTexture.setAlpha( 192 );
-	gBlueTexture.setAlpha( 192 );
-	gShimmerTexture.setAlpha( 192 );
 
 	return success;
 }
 
 void close()
 {
+	//Stop particle workers
+	gParticles.stop();
+
 	//Free loaded images
-	gDotTexture.free();
-	gRedTexture.free();
-	gGreenTexture.free();
-	gBlueTexture.free();
-	gShimmerTexture.free();
+	dot.free();
+	for( int i = 0; i < TOTAL_WANDERERS; ++i )
+	{
+		gWanderers[ i ].free();
+	}
+	gParticleAtlas.free();
+	gTextureCache.clear();
 
 	//Destroy window	
 	SDL_DestroyRenderer( gRenderer );
@@ -575,9 +1884,6 @@ void close()
 //Main loop flag
 bool quit = false;
 
-//The dot that will be moving around on the screen
-Dot dot;
-
 void loop_handler(void*)
 {
 	//Event handler
@@ -596,8 +1902,15 @@ void loop_handler(void*)
 		dot.handleEvent( e );
 	}
 
-	//Move the dot
+	//Move the dots
 	dot.move();
+	for( int i = 0; i < TOTAL_WANDERERS; ++i )
+	{
+		gWanderers[ i ].move();
+	}
+
+	//Animate particles by one frame
+	gParticles.update( 1.f );
 
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
@@ -605,6 +1918,13 @@ void loop_handler(void*)
 
 	//Render objects
 	dot.render();
+	for( int i = 0; i < TOTAL_WANDERERS; ++i )
+	{
+		gWanderers[ i ].render();
+	}
+
+	//Show particles on top of dot
+	gParticles.render();
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -613,6 +1933,12 @@ void loop_handler(void*)
  
 int main( int argc, char* args[] )
 {
+	//Compare the particle kernels instead of running the demo
+	if( argc > 1 && strcmp( args[ 1 ], "--bench" ) == 0 )
+	{
+		return benchParticles();
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -626,7 +1952,10 @@ int main( int argc, char* args[] )
 			printf( "Failed to load media!\n" );
 		}
 		else
-		{	
+		{
+			//Update particles off the render thread
+			gParticles.start();
+
 #ifdef _JS
 
                         emscripten_set_main_loop_arg(loop_handler, NULL, -1, 1);
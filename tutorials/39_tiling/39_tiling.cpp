@@ -1,12 +1,25 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, strings, and file streams
+//Using SDL, SDL_image, SDL_thread, standard IO, math, strings, file streams, containers, and memory mapped files
 #include <SDL.h>
 #include <SDL_image.h>
+#include <SDL_thread.h>
 #include <stdio.h>
+#include <string.h>
+#include <cmath>
 #include <string>
 #include <fstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -15,10 +28,13 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
-//The dimensions of the level
+//The dimensions of the level in the text map format, binary maps store their own
 const int LEVEL_WIDTH = 1280;
 const int LEVEL_HEIGHT = 960;
 
+//Memory the streamed world may keep resident
+const int WORLD_MEMORY_BUDGET = 64 * 1024 * 1024;
+
 //Tile constants
 const int TILE_WIDTH = 80;
 const int TILE_HEIGHT = 80;
@@ -39,6 +55,30 @@ const int TILE_BOTTOMLEFT = 9;
 const int TILE_LEFT = 10;
 const int TILE_TOPLEFT = 11;
 
+//Header of a binary tile map, followed by one byte per tile for each layer, row by row
+//All fields are little endian
+struct TileMapHeader
+{
+	//Always "LMAP"
+	char magic[ 4 ];
+
+	//Format version
+	Uint32 version;
+
+	//Map dimensions in tiles
+	Uint32 columns;
+	Uint32 rows;
+
+	//Number of tile layers, the first one holds the level tiles
+	Uint32 layers;
+};
+
+//Binary tile map format version
+const Uint32 TILE_MAP_VERSION = 1;
+
+//Checks a binary tile map header against the size of its file
+bool checkTileMapHeader( TileMapHeader& header, Uint64 fileSize, std::string path );
+
 //Texture wrapper class
 class LTexture
 {
@@ -76,6 +116,9 @@ class LTexture
 		int getWidth();
 		int getHeight();
 
+		//Gets the hardware texture
+		SDL_Texture* getTexture();
+
 	private:
 		//The actual hardware texture
 		SDL_Texture* mTexture;
@@ -85,28 +128,263 @@ class LTexture
 		int mHeight;
 };
 
-//The tile
-class Tile
+//Collects sprites into one vertex array and draws them with a single geometry call per texture
+class SpriteBatch
 {
-    public:
-		//Initializes position and type
-		Tile( int x, int y, int tileType );
+	public:
+		//Initializes variables
+		SpriteBatch();
+
+		//Queues a sprite with the same arguments as LTexture::render, rotation and flipping are done on the CPU
+		void draw( LTexture& texture, int x, int y, SDL_Rect* clip = NULL, double angle = 0.0, SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE );
+
+		//Renders all queued sprites and empties the batch
+		void flush();
+
+		//Gets number of queued sprites
+		int getCount();
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	private:
+		//The texture of the queued sprites
+		SDL_Texture* mTexture;
+
+		//Four vertices and six indices per queued sprite
+		std::vector<SDL_Vertex> mVertices;
+		std::vector<int> mIndices;
+#endif
+};
+
+//The level, stored as a flat array of tile types
+class TileMap
+{
+	public:
+		//Number of tiles along each side of a baked chunk
+		static const int CHUNK_TILES = 16;
+
+		//Initializes variables
+		TileMap();
+
+		//Deallocates memory
+		~TileMap();
+
+		//Allocates a map of the given size in tiles
+		void create( int columns, int rows );
+
+		//Maps a binary tile map file, returns false without a message if the file doesn't exist
+		//Without an index the tiles are neither checked nor given wall bits, only getLayer may be used to read them
+		bool loadFromFile( std::string path, bool index = true );
 
-		//Shows the tile
+		//Saves the map in the binary tile map format
+		bool saveToFile( std::string path );
+
+		//Sets the type of a tile, which invalidates its baked chunk
+		void setType( int column, int row, int type );
+
+		//Gets the type of a tile
+		int getType( int column, int row );
+
+		//Checks if a tile is a wall tile
+		bool isWall( int column, int row );
+
+		//Checks collision box against the wall tiles it covers
+		bool touchesWall( SDL_Rect box );
+
+		//Checks many collision boxes at once, sets their hit flags and returns the number of hits
+		int touchesWall( SDL_Rect boxes[], int count, bool hits[] );
+
+		//Gets the map dimensions in tiles
+		int getColumns();
+		int getRows();
+
+		//Gets the tile types of a layer, row by row
+		Uint8* getLayer( int layer );
+
+		//Gets number of layers
+		int getLayerCount();
+
+		//Gets the range of tiles under the camera, false if the camera is off the map
+		bool getVisibleRange( SDL_Rect& camera, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow );
+
+		//Shows the tiles under the camera one by one
 		void render( SDL_Rect& camera );
 
-		//Get the tile type
-		int getType();
+		//Shows the chunks under the camera, baking the ones that aren't baked yet
+		void renderChunks( SDL_Rect& camera );
 
-		//Get the collision box
-		SDL_Rect getBox();
+		//Throws away baked chunks, they are baked again when next shown
+		void invalidateChunks();
 
-    private:
-		//The attributes of the tile
-		SDL_Rect mBox;
+		//Deallocates tiles and chunks
+		void free();
+
+	private:
+		//Allocates the wall bits and chunk slots for the map dimensions
+		void allocateIndex();
+
+		//Sets the wall bit of a tile from its type
+		void updateWall( int column, int row );
+
+		//Queues and shows a range of tiles
+		void renderRange( SDL_Rect& camera, int firstColumn, int firstRow, int lastColumn, int lastRow );
+
+		//Renders the tiles of a chunk into its texture
+		SDL_Texture* bakeChunk( int chunkColumn, int chunkRow );
+
+		//Map dimensions in tiles
+		int mColumns;
+		int mRows;
+
+		//The tile types of the first layer, row by row
+		Uint8* mTypes;
+
+		//Number of layers stored after each other at mTypes
+		int mLayers;
+
+		//The tile types when the map isn't mapped from a file
+		std::vector<Uint8> mOwnedTypes;
+
+		//The memory mapped map file
+		void* mMappedFile;
+		size_t mMappedSize;
+
+		//One bit per tile set for wall tiles, each row padded to whole words
+		int mWallWordsPerRow;
+		std::vector<Uint64> mWalls;
+
+		//Map dimensions in chunks
+		int mChunkColumns;
+		int mChunkRows;
+
+		//The baked chunk textures, NULL when not baked
+		std::vector<SDL_Texture*> mChunks;
+};
+
+//The loading states of a streamed chunk
+enum WorldChunkState
+{
+	CHUNK_QUEUED,
+	CHUNK_PREPARED,
+	CHUNK_RESIDENT
+};
+
+//A streamed square of the world
+struct WorldChunk
+{
+	//Chunk coordinates
+	int column;
+	int row;
 
-		//The tile type
-		int mType;
+	//Loading state, only changed on the render thread
+	WorldChunkState state;
+
+	//The chunk's tiles, filled by the loader
+	TileMap tiles;
+
+	//The chunk's pixels drawn by the loader, waiting to be uploaded
+	SDL_Surface* surface;
+
+	//The uploaded chunk
+	SDL_Texture* texture;
+};
+
+//A level too big to keep loaded, streamed in chunks around the camera from a binary tile map
+class TileWorld
+{
+	public:
+		//Number of tiles along each side of a streamed chunk
+		static const int CHUNK_TILES = 8;
+
+		//Number of chunks loaded ahead around the screen
+		static const int CHUNK_MARGIN = 1;
+
+		//Number of chunks uploaded per frame
+		static const int UPLOADS_PER_FRAME = 2;
+
+		//Initializes variables
+		TileWorld();
+
+		//Deallocates memory
+		~TileWorld();
+
+		//Opens the binary map and starts the loader thread
+		bool open( std::string mapPath, std::string sheetPath, int memoryBudget );
+
+		//Requests the chunks around the camera, uploads loaded ones, and evicts far ones over budget
+		void update( SDL_Rect& camera );
+
+		//Waits until the chunks under the camera are loaded
+		void preload( SDL_Rect& camera );
+
+		//Shows the loaded chunks under the camera
+		void render( SDL_Rect& camera );
+
+		//Checks collision box against wall tiles, chunks that aren't loaded yet count as walls
+		bool touchesWall( SDL_Rect box );
+
+		//Checks many collision boxes in level coordinates at once, sets their hit flags and returns the number of hits
+		int touchesWall( SDL_Rect boxes[], int count, bool hits[] );
+
+		//Gets the level dimensions
+		int getWidth();
+		int getHeight();
+
+		//Gets the bytes held by resident chunks
+		int getResidentBytes();
+
+		//Stops the loader and deallocates chunks
+		void free();
+
+	private:
+		//Loader thread entry point
+		static int loaderThread( void* data );
+
+		//Loads queued chunks until the world is freed
+		void runLoader();
+
+		//Reads a chunk's tiles and draws its pixels
+		void loadChunk( WorldChunk* chunk );
+
+		//Gets a chunk by coordinates, NULL if it isn't requested
+		WorldChunk* findChunk( int column, int row );
+
+		//Gets squared distance from a chunk's center to a point
+		Sint64 getDistance( WorldChunk* chunk, int x, int y );
+
+		//Deallocates a chunk
+		void deleteChunk( WorldChunk* chunk );
+
+		//Map dimensions in tiles and chunks
+		int mColumns;
+		int mRows;
+		int mChunkColumns;
+		int mChunkRows;
+
+		//The memory mapped binary map, read by the loader a chunk at a time
+		TileMap mMap;
+
+		//The tile sheet the loader draws chunks with
+		SDL_Surface* mSheet;
+
+		//Every requested chunk by index, only used on the render thread
+		std::map<int, WorldChunk*> mChunks;
+
+		//Chunks waiting for the loader, nearest first, and chunks the loader is done with
+		std::deque<WorldChunk*> mQueue;
+		std::vector<WorldChunk*> mPrepared;
+
+		//Loaded chunks waiting for upload, only used on the render thread
+		std::vector<WorldChunk*> mUploads;
+
+		//The loader thread and what guards the queues
+		SDL_Thread* mThread;
+		SDL_mutex* mLock;
+		SDL_cond* mHasWork;
+		bool mQuit;
+
+		//Memory accounting
+		int mBudget;
+		int mResidentBytes;
 };
 
 //The dot that will move around on the screen
@@ -127,10 +405,10 @@ class Dot
 		void handleEvent( SDL_Event& e );
 
 		//Moves the dot and check collision against tiles
-		void move( Tile *tiles[] );
+		void move( TileWorld& world );
 
 		//Centers the camera over the dot
-		void setCamera( SDL_Rect& camera );
+		void setCamera( SDL_Rect& camera, TileWorld& world );
 
 		//Shows the dot on the screen
 		void render( SDL_Rect& camera );
@@ -147,211 +425,1291 @@ class Dot
 bool init();
 
 //Loads media
-bool loadMedia( Tile* tiles[] );
+bool loadMedia( TileWorld& world );
 
 //Frees media and shuts down SDL
-void close( Tile* tiles[] );
+void close( TileWorld& world );
+
+//Sets tiles from tile map
+bool setTiles( TileWorld& world );
+
+//Parses a text tile map
+bool loadTextMap( TileMap& tiles, std::string path );
+
+//Converts a text tile map to the binary format
+bool convertTextMap( std::string textPath, std::string binaryPath );
+
+//The window we'll be rendering to
+SDL_Window* gWindow = NULL;
+
+//The window renderer
+SDL_Renderer* gRenderer = NULL;
+
+//Scene textures
+LTexture gDotTexture;
+LTexture gTileTexture;
+SDL_Rect gTileClips[ TOTAL_TILE_SPRITES ];
+
+//Batch the level tiles are drawn through
+SpriteBatch gSpriteBatch;
+
+LTexture::LTexture()
+{
+	//Initialize
+	mTexture = NULL;
+	mWidth = 0;
+	mHeight = 0;
+}
+
+LTexture::~LTexture()
+{
+	//Deallocate
+	free();
+}
+
+bool LTexture::loadFromFile( std::string path )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//The final texture
+	SDL_Texture* newTexture = NULL;
+
+	//Load image at specified path
+	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
+	if( loadedSurface == NULL )
+	{
+		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
+	}
+	else
+	{
+		//Color key image
+		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
+
+		//Create texture from surface pixels
+        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
+		if( newTexture == NULL )
+		{
+			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		}
+		else
+		{
+			//Get image dimensions
+			mWidth = loadedSurface->w;
+			mHeight = loadedSurface->h;
+		}
+
+		//Get rid of old loaded surface
+		SDL_FreeSurface( loadedSurface );
+	}
+
+	//Return success
+	mTexture = newTexture;
+	return mTexture != NULL;
+}
+
+#ifdef _SDL_TTF_H
+bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//Render text surface
+	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
+	if( textSurface != NULL )
+	{
+		//Create texture from surface pixels
+        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+		if( mTexture == NULL )
+		{
+			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Get image dimensions
+			mWidth = textSurface->w;
+			mHeight = textSurface->h;
+		}
+
+		//Get rid of old surface
+		SDL_FreeSurface( textSurface );
+	}
+	else
+	{
+		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+	}
+
+	
+	//Return success
+	return mTexture != NULL;
+}
+#endif
+
+void LTexture::free()
+{
+	//Free texture if it exists
+	if( mTexture != NULL )
+	{
+		SDL_DestroyTexture( mTexture );
+		mTexture = NULL;
+		mWidth = 0;
+		mHeight = 0;
+	}
+}
+
+void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
+{
+	//Modulate texture rgb
+	SDL_SetTextureColorMod( mTexture, red, green, blue );
+}
+
+void LTexture::setBlendMode( SDL_BlendMode blending )
+{
+	//Set blending function
+	SDL_SetTextureBlendMode( mTexture, blending );
+}
+		
+void LTexture::setAlpha( Uint8 alpha )
+{
+	//Modulate texture alpha
+	SDL_SetTextureAlphaMod( mTexture, alpha );
+}
+
+void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
+{
+	//Set rendering space and render to screen
+	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
+
+	//Set clip rendering dimensions
+	if( clip != NULL )
+	{
+		renderQuad.w = clip->w;
+		renderQuad.h = clip->h;
+	}
+
+	//Render to screen
+	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
+}
+
+int LTexture::getWidth()
+{
+	return mWidth;
+}
+
+int LTexture::getHeight()
+{
+	return mHeight;
+}
+
+SDL_Texture* LTexture::getTexture()
+{
+	return mTexture;
+}
+
+SpriteBatch::SpriteBatch()
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Initialize
+	mTexture = NULL;
+#endif
+}
+
+void SpriteBatch::draw( LTexture& texture, int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Sprites of another texture can't share the draw call
+	if( texture.getTexture() != mTexture )
+	{
+		flush();
+		mTexture = texture.getTexture();
+	}
+
+	//Source rectangle, whole texture by default
+	SDL_Rect source = { 0, 0, texture.getWidth(), texture.getHeight() };
+	if( clip != NULL )
+	{
+		source = *clip;
+	}
+
+	//Texture coordinates of the source rectangle
+	float u0 = (float)source.x / texture.getWidth();
+	float v0 = (float)source.y / texture.getHeight();
+	float u1 = (float)( source.x + source.w ) / texture.getWidth();
+	float v1 = (float)( source.y + source.h ) / texture.getHeight();
+
+	//Flip by swapping texture coordinates
+	if( flip & SDL_FLIP_HORIZONTAL )
+	{
+		float temp = u0; u0 = u1; u1 = temp;
+	}
+	if( flip & SDL_FLIP_VERTICAL )
+	{
+		float temp = v0; v0 = v1; v1 = temp;
+	}
+
+	//Corners relative to the sprite position
+	float cornerX[ 4 ] = { 0.f, (float)source.w, (float)source.w, 0.f };
+	float cornerY[ 4 ] = { 0.f, 0.f, (float)source.h, (float)source.h };
+	float cornerU[ 4 ] = { u0, u1, u1, u0 };
+	float cornerV[ 4 ] = { v0, v0, v1, v1 };
+
+	//Rotate corners clockwise around the center like SDL_RenderCopyEx
+	if( angle != 0.0 )
+	{
+		float centerX = center != NULL ? center->x : source.w / 2.f;
+		float centerY = center != NULL ? center->y : source.h / 2.f;
+		float radians = (float)( angle * M_PI / 180.0 );
+		float c = cosf( radians );
+		float s = sinf( radians );
+
+		for( int i = 0; i < 4; ++i )
+		{
+			float dx = cornerX[ i ] - centerX;
+			float dy = cornerY[ i ] - centerY;
+			cornerX[ i ] = centerX + dx * c - dy * s;
+			cornerY[ i ] = centerY + dx * s + dy * c;
+		}
+	}
+
+	//Queue the two triangles of the quad
+	int first = mVertices.size();
+	for( int i = 0; i < 4; ++i )
+	{
+		SDL_Vertex vertex;
+		vertex.position.x = x + cornerX[ i ];
+		vertex.position.y = y + cornerY[ i ];
+		vertex.color.r = 0xFF;
+		vertex.color.g = 0xFF;
+		vertex.color.b = 0xFF;
+		vertex.color.a = 0xFF;
+		vertex.tex_coord.x = cornerU[ i ];
+		vertex.tex_coord.y = cornerV[ i ];
+		mVertices.push_back( vertex );
+	}
+
+	mIndices.push_back( first );
+	mIndices.push_back( first + 1 );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first );
+	mIndices.push_back( first + 2 );
+	mIndices.push_back( first + 3 );
+#else
+	//No geometry rendering, draw right away
+	texture.render( x, y, clip, angle, center, flip );
+#endif
+}
+
+void SpriteBatch::flush()
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Draw every queued sprite at once
+	if( !mIndices.empty() )
+	{
+		SDL_RenderGeometry( gRenderer, mTexture, &mVertices[ 0 ], mVertices.size(), &mIndices[ 0 ], mIndices.size() );
+	}
+
+	//Empty the batch but keep its memory
+	mVertices.clear();
+	mIndices.clear();
+#endif
+}
+
+int SpriteBatch::getCount()
+{
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	return mVertices.size() / 4;
+#else
+	//Sprites are drawn as they are queued
+	return 0;
+#endif
+}
+
+TileMap::TileMap()
+{
+	//Initialize
+	mColumns = 0;
+	mRows = 0;
+	mTypes = NULL;
+	mLayers = 0;
+	mMappedFile = NULL;
+	mMappedSize = 0;
+	mWallWordsPerRow = 0;
+	mChunkColumns = 0;
+	mChunkRows = 0;
+}
+
+TileMap::~TileMap()
+{
+	//Deallocate
+	free();
+}
+
+void TileMap::create( int columns, int rows )
+{
+	//Get rid of preexisting map
+	free();
+
+	//Allocate the tiles in one block
+	mColumns = columns;
+	mRows = rows;
+	mLayers = 1;
+	mOwnedTypes.assign( columns * rows, TILE_RED );
+	mTypes = &mOwnedTypes[ 0 ];
+
+	//The default tile isn't a wall
+	allocateIndex();
+}
+
+bool TileMap::loadFromFile( std::string path, bool index )
+{
+	//Get rid of preexisting map
+	free();
+
+	//The file contents
+	Uint8* data = NULL;
+	size_t size = 0;
+
+#ifndef _WIN32
+	//Map the file, the mapping is private so setType doesn't write back to it
+	int file = open( path.c_str(), O_RDONLY );
+	if( file == -1 )
+	{
+		return false;
+	}
+
+	struct stat info;
+	if( fstat( file, &info ) == 0 && info.st_size > 0 )
+	{
+		void* mapping = mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0 );
+		if( mapping != MAP_FAILED )
+		{
+			mMappedFile = mapping;
+			mMappedSize = info.st_size;
+			data = (Uint8*)mapping;
+			size = info.st_size;
+		}
+	}
+	::close( file );
+#endif
+
+	//Without a mapping read the file in one block
+	if( data == NULL )
+	{
+		SDL_RWops* file = SDL_RWFromFile( path.c_str(), "rb" );
+		if( file == NULL )
+		{
+			return false;
+		}
+
+		Sint64 fileSize = SDL_RWsize( file );
+		if( fileSize > 0 )
+		{
+			mOwnedTypes.resize( fileSize );
+			size = SDL_RWread( file, &mOwnedTypes[ 0 ], 1, fileSize );
+			data = &mOwnedTypes[ 0 ];
+		}
+		SDL_RWclose( file );
+	}
+
+	//Read the header
+	TileMapHeader header;
+	if( data == NULL || size < sizeof( header ) )
+	{
+		printf( "Error loading map %s: File is too small!\n", path.c_str() );
+		free();
+		return false;
+	}
+	memcpy( &header, data, sizeof( header ) );
+	if( !checkTileMapHeader( header, size, path ) )
+	{
+		free();
+		return false;
+	}
+
+	//Use the tiles where they are
+	mColumns = header.columns;
+	mRows = header.rows;
+	mLayers = header.layers;
+	mTypes = data + sizeof( header );
+
+	//Leave the tiles unread, the pages are only touched when a reader gets to them
+	if( !index )
+	{
+		return true;
+	}
+	allocateIndex();
+
+	//Check the level tiles and build the wall bits
+	for( int row = 0; row < mRows; ++row )
+	{
+		for( int column = 0; column < mColumns; ++column )
+		{
+			if( mTypes[ row * mColumns + column ] >= TOTAL_TILE_SPRITES )
+			{
+				printf( "Error loading map %s: Invalid tile type at %d!\n", path.c_str(), row * mColumns + column );
+				free();
+				return false;
+			}
+
+			updateWall( column, row );
+		}
+	}
+
+	return true;
+}
+
+bool checkTileMapHeader( TileMapHeader& header, Uint64 fileSize, std::string path )
+{
+	//Convert the header from little endian
+	header.version = SDL_SwapLE32( header.version );
+	header.columns = SDL_SwapLE32( header.columns );
+	header.rows = SDL_SwapLE32( header.rows );
+	header.layers = SDL_SwapLE32( header.layers );
+
+	//Check the header against the file
+	if( memcmp( header.magic, "LMAP", 4 ) != 0 || header.version != TILE_MAP_VERSION )
+	{
+		printf( "Error loading map %s: Not a version %d tile map!\n", path.c_str(), (int)TILE_MAP_VERSION );
+		return false;
+	}
+	if( header.columns == 0 || header.rows == 0 || header.layers == 0 || header.columns > 0xFFFF || header.rows > 0xFFFF ||
+		(Uint64)header.columns * header.rows * header.layers > fileSize - sizeof( header ) )
+	{
+		printf( "Error loading map %s: Bad dimensions!\n", path.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+bool TileMap::saveToFile( std::string path )
+{
+	//Open the file for writing in binary
+	SDL_RWops* file = SDL_RWFromFile( path.c_str(), "wb" );
+	if( file == NULL )
+	{
+		printf( "Unable to create map file %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		return false;
+	}
+
+	//Write the header
+	TileMapHeader header;
+	memcpy( header.magic, "LMAP", 4 );
+	header.version = SDL_SwapLE32( TILE_MAP_VERSION );
+	header.columns = SDL_SwapLE32( mColumns );
+	header.rows = SDL_SwapLE32( mRows );
+	header.layers = SDL_SwapLE32( mLayers );
+
+	//Write the layers
+	size_t layerSize = mColumns * mRows * mLayers;
+	bool success = SDL_RWwrite( file, &header, sizeof( header ), 1 ) == 1 && SDL_RWwrite( file, mTypes, 1, layerSize ) == layerSize;
+	if( !success )
+	{
+		printf( "Unable to write map file %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+	}
+
+	SDL_RWclose( file );
+	return success;
+}
+
+void TileMap::allocateIndex()
+{
+	//Allocate the wall bits
+	mWallWordsPerRow = ( mColumns + 63 ) / 64;
+	mWalls.assign( mWallWordsPerRow * mRows, 0 );
+
+	//Allocate the chunk slots, partial chunks at the edges included
+	mChunkColumns = ( mColumns + CHUNK_TILES - 1 ) / CHUNK_TILES;
+	mChunkRows = ( mRows + CHUNK_TILES - 1 ) / CHUNK_TILES;
+	mChunks.assign( mChunkColumns * mChunkRows, (SDL_Texture*)NULL );
+}
+
+void TileMap::updateWall( int column, int row )
+{
+	//Keep the wall bit in sync with the type
+	int type = mTypes[ row * mColumns + column ];
+	Uint64& wallWord = mWalls[ row * mWallWordsPerRow + column / 64 ];
+	Uint64 wallBit = (Uint64)1 << ( column % 64 );
+	if( ( type >= TILE_CENTER ) && ( type <= TILE_TOPLEFT ) )
+	{
+		wallWord |= wallBit;
+	}
+	else
+	{
+		wallWord &= ~wallBit;
+	}
+}
+
+void TileMap::setType( int column, int row, int type )
+{
+	mTypes[ row * mColumns + column ] = type;
+	updateWall( column, row );
+
+	//The chunk holding the tile is out of date
+	int chunk = ( row / CHUNK_TILES ) * mChunkColumns + column / CHUNK_TILES;
+	if( mChunks[ chunk ] != NULL )
+	{
+		SDL_DestroyTexture( mChunks[ chunk ] );
+		mChunks[ chunk ] = NULL;
+	}
+}
+
+int TileMap::getType( int column, int row )
+{
+	return mTypes[ row * mColumns + column ];
+}
+
+bool TileMap::isWall( int column, int row )
+{
+	return ( mWalls[ row * mWallWordsPerRow + column / 64 ] >> ( column % 64 ) ) & 1;
+}
+
+bool TileMap::touchesWall( SDL_Rect box )
+{
+	//Empty boxes and boxes off the map touch nothing
+	if( box.w <= 0 || box.h <= 0 || box.x + box.w <= 0 || box.y + box.h <= 0 || box.x >= mColumns * TILE_WIDTH || box.y >= mRows * TILE_HEIGHT )
+	{
+		return false;
+	}
+
+	//The tiles the box overlaps, clamped to the map
+	int firstColumn = box.x < 0 ? 0 : box.x / TILE_WIDTH;
+	int firstRow = box.y < 0 ? 0 : box.y / TILE_HEIGHT;
+	int lastColumn = SDL_min( ( box.x + box.w - 1 ) / TILE_WIDTH, mColumns - 1 );
+	int lastRow = SDL_min( ( box.y + box.h - 1 ) / TILE_HEIGHT, mRows - 1 );
+
+	//Go through the overlapped rows
+	for( int row = firstRow; row <= lastRow; ++row )
+	{
+		//Test the overlapped columns a word at a time
+		const Uint64* rowWalls = &mWalls[ row * mWallWordsPerRow ];
+		for( int word = firstColumn / 64; word <= lastColumn / 64; ++word )
+		{
+			//Bits of the overlapped columns within this word
+			int firstBit = word == firstColumn / 64 ? firstColumn % 64 : 0;
+			int lastBit = word == lastColumn / 64 ? lastColumn % 64 : 63;
+			Uint64 columns = ( ~(Uint64)0 >> ( 63 - lastBit ) ) & ( ~(Uint64)0 << firstBit );
+
+			if( rowWalls[ word ] & columns )
+			{
+				return true;
+			}
+		}
+	}
+
+	//If no wall tiles were touched
+	return false;
+}
+
+int TileMap::touchesWall( SDL_Rect boxes[], int count, bool hits[] )
+{
+	//Test each box against the wall bits
+	int hitCount = 0;
+	for( int i = 0; i < count; ++i )
+	{
+		hits[ i ] = touchesWall( boxes[ i ] );
+		if( hits[ i ] )
+		{
+			++hitCount;
+		}
+	}
+
+	return hitCount;
+}
+
+int TileMap::getColumns()
+{
+	return mColumns;
+}
+
+int TileMap::getRows()
+{
+	return mRows;
+}
+
+Uint8* TileMap::getLayer( int layer )
+{
+	return mTypes + layer * mColumns * mRows;
+}
+
+int TileMap::getLayerCount()
+{
+	return mLayers;
+}
+
+bool TileMap::getVisibleRange( SDL_Rect& camera, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow )
+{
+	//The camera is entirely off the map
+	if( camera.x + camera.w <= 0 || camera.y + camera.h <= 0 || camera.x >= mColumns * TILE_WIDTH || camera.y >= mRows * TILE_HEIGHT )
+	{
+		return false;
+	}
+
+	//Tiles under the camera edges, clamped to the map
+	firstColumn = camera.x < 0 ? 0 : camera.x / TILE_WIDTH;
+	firstRow = camera.y < 0 ? 0 : camera.y / TILE_HEIGHT;
+	lastColumn = ( camera.x + camera.w - 1 ) / TILE_WIDTH;
+	lastRow = ( camera.y + camera.h - 1 ) / TILE_HEIGHT;
+	if( lastColumn >= mColumns )
+	{
+		lastColumn = mColumns - 1;
+	}
+	if( lastRow >= mRows )
+	{
+		lastRow = mRows - 1;
+	}
+
+	return true;
+}
+
+void TileMap::render( SDL_Rect& camera )
+{
+	//Show the tiles on screen
+	int firstColumn, firstRow, lastColumn, lastRow;
+	if( getVisibleRange( camera, firstColumn, firstRow, lastColumn, lastRow ) )
+	{
+		renderRange( camera, firstColumn, firstRow, lastColumn, lastRow );
+	}
+}
+
+void TileMap::renderRange( SDL_Rect& camera, int firstColumn, int firstRow, int lastColumn, int lastRow )
+{
+	//Queue the tiles
+	for( int row = firstRow; row <= lastRow; ++row )
+	{
+		for( int column = firstColumn; column <= lastColumn; ++column )
+		{
+			gSpriteBatch.draw( gTileTexture, column * TILE_WIDTH - camera.x, row * TILE_HEIGHT - camera.y, &gTileClips[ getType( column, row ) ] );
+		}
+	}
+
+	//Show the tiles
+	gSpriteBatch.flush();
+}
+
+void TileMap::renderChunks( SDL_Rect& camera )
+{
+	//Get the tiles on screen
+	int firstColumn, firstRow, lastColumn, lastRow;
+	if( !getVisibleRange( camera, firstColumn, firstRow, lastColumn, lastRow ) )
+	{
+		return;
+	}
+
+	//Go through the chunks holding those tiles
+	for( int chunkRow = firstRow / CHUNK_TILES; chunkRow <= lastRow / CHUNK_TILES; ++chunkRow )
+	{
+		for( int chunkColumn = firstColumn / CHUNK_TILES; chunkColumn <= lastColumn / CHUNK_TILES; ++chunkColumn )
+		{
+			//Bake the chunk the first time it is seen
+			SDL_Texture*& chunk = mChunks[ chunkRow * mChunkColumns + chunkColumn ];
+			if( chunk == NULL )
+			{
+				chunk = bakeChunk( chunkColumn, chunkRow );
+			}
+
+			if( chunk != NULL )
+			{
+				//Show the whole chunk at once
+				SDL_Rect renderQuad = { chunkColumn * CHUNK_TILES * TILE_WIDTH - camera.x, chunkRow * CHUNK_TILES * TILE_HEIGHT - camera.y, CHUNK_TILES * TILE_WIDTH, CHUNK_TILES * TILE_HEIGHT };
+				SDL_RenderCopy( gRenderer, chunk, NULL, &renderQuad );
+			}
+			else
+			{
+				//No render targets, show the visible tiles of the chunk instead
+				renderRange( camera,
+					SDL_max( firstColumn, chunkColumn * CHUNK_TILES ), SDL_max( firstRow, chunkRow * CHUNK_TILES ),
+					SDL_min( lastColumn, chunkColumn * CHUNK_TILES + CHUNK_TILES - 1 ), SDL_min( lastRow, chunkRow * CHUNK_TILES + CHUNK_TILES - 1 ) );
+			}
+		}
+	}
+}
+
+void TileMap::invalidateChunks()
+{
+	//Free baked chunks
+	for( int i = 0; i < (int)mChunks.size(); ++i )
+	{
+		if( mChunks[ i ] != NULL )
+		{
+			SDL_DestroyTexture( mChunks[ i ] );
+			mChunks[ i ] = NULL;
+		}
+	}
+}
+
+void TileMap::free()
+{
+	//Free chunks and tiles
+	invalidateChunks();
+	mChunks.clear();
+	mWalls.clear();
+
+	//Unmap the map file
+#ifndef _WIN32
+	if( mMappedFile != NULL )
+	{
+		munmap( mMappedFile, mMappedSize );
+	}
+#endif
+	mMappedFile = NULL;
+	mMappedSize = 0;
+	mOwnedTypes.clear();
+	mTypes = NULL;
+	mLayers = 0;
+	mColumns = 0;
+	mRows = 0;
+	mWallWordsPerRow = 0;
+	mChunkColumns = 0;
+	mChunkRows = 0;
+}
+
+SDL_Texture* TileMap::bakeChunk( int chunkColumn, int chunkRow )
+{
+	//Create the chunk texture as a render target
+	SDL_Texture* chunk = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, CHUNK_TILES * TILE_WIDTH, CHUNK_TILES * TILE_HEIGHT );
+	if( chunk == NULL )
+	{
+		return NULL;
+	}
+
+	//Draw into the chunk
+	SDL_SetTextureBlendMode( chunk, SDL_BLENDMODE_BLEND );
+	SDL_SetRenderTarget( gRenderer, chunk );
+	SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0x00 );
+	SDL_RenderClear( gRenderer );
+
+	//Queue the chunk's tiles relative to its corner
+	int firstColumn = chunkColumn * CHUNK_TILES;
+	int firstRow = chunkRow * CHUNK_TILES;
+	for( int row = firstRow; row < firstRow + CHUNK_TILES && row < mRows; ++row )
+	{
+		for( int column = firstColumn; column < firstColumn + CHUNK_TILES && column < mColumns; ++column )
+		{
+			gSpriteBatch.draw( gTileTexture, ( column - firstColumn ) * TILE_WIDTH, ( row - firstRow ) * TILE_HEIGHT, &gTileClips[ getType( column, row ) ] );
+		}
+	}
+	gSpriteBatch.flush();
+
+	//Go back to drawing on the screen
+	SDL_SetRenderTarget( gRenderer, NULL );
+
+	return chunk;
+}
+
+TileWorld::TileWorld()
+{
+	//Initialize
+	mColumns = 0;
+	mRows = 0;
+	mChunkColumns = 0;
+	mChunkRows = 0;
+	mSheet = NULL;
+	mThread = NULL;
+	mLock = NULL;
+	mHasWork = NULL;
+	mQuit = false;
+	mBudget = 0;
+	mResidentBytes = 0;
+}
+
+TileWorld::~TileWorld()
+{
+	//Deallocate
+	free();
+}
+
+bool TileWorld::open( std::string mapPath, std::string sheetPath, int memoryBudget )
+{
+	//Get rid of preexisting world
+	free();
+
+	//Map the file without reading the tiles, they are paged in as chunks are streamed
+	if( !mMap.loadFromFile( mapPath, false ) )
+	{
+		printf( "Unable to open map %s!\n", mapPath.c_str() );
+		return false;
+	}
+
+	//Store the map layout
+	mColumns = mMap.getColumns();
+	mRows = mMap.getRows();
+	mChunkColumns = ( mColumns + CHUNK_TILES - 1 ) / CHUNK_TILES;
+	mChunkRows = ( mRows + CHUNK_TILES - 1 ) / CHUNK_TILES;
+	mBudget = memoryBudget;
+
+	//Load the tile sheet for the loader in the same format as the chunks
+	SDL_Surface* loadedSurface = IMG_Load( sheetPath.c_str() );
+	if( loadedSurface == NULL )
+	{
+		printf( "Unable to load image %s! SDL_image Error: %s\n", sheetPath.c_str(), IMG_GetError() );
+		return false;
+	}
+	SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
+	mSheet = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA32, 0 );
+	SDL_FreeSurface( loadedSurface );
+	if( mSheet == NULL )
+	{
+		printf( "Unable to convert tile sheet! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+	SDL_SetSurfaceBlendMode( mSheet, SDL_BLENDMODE_NONE );
+
+	//Start the loader
+	mLock = SDL_CreateMutex();
+	mHasWork = SDL_CreateCond();
+	mQuit = false;
+	mThread = SDL_CreateThread( loaderThread, "ChunkLoader", this );
+	if( mThread == NULL )
+	{
+		printf( "Unable to create loader thread, chunks load on the render thread! SDL Error: %s\n", SDL_GetError() );
+	}
+
+	return true;
+}
+
+void TileWorld::update( SDL_Rect& camera )
+{
+	//The chunks under the screen plus the margin, clamped to the map
+	int chunkWidth = CHUNK_TILES * TILE_WIDTH;
+	int chunkHeight = CHUNK_TILES * TILE_HEIGHT;
+	int firstColumn = SDL_max( camera.x / chunkWidth - CHUNK_MARGIN, 0 );
+	int firstRow = SDL_max( camera.y / chunkHeight - CHUNK_MARGIN, 0 );
+	int lastColumn = SDL_min( ( camera.x + camera.w - 1 ) / chunkWidth + CHUNK_MARGIN, mChunkColumns - 1 );
+	int lastRow = SDL_min( ( camera.y + camera.h - 1 ) / chunkHeight + CHUNK_MARGIN, mChunkRows - 1 );
+	int centerX = camera.x + camera.w / 2;
+	int centerY = camera.y + camera.h / 2;
+
+	//Request the chunks that aren't known yet
+	std::vector<WorldChunk*> requests;
+	for( int row = firstRow; row <= lastRow; ++row )
+	{
+		for( int column = firstColumn; column <= lastColumn; ++column )
+		{
+			if( findChunk( column, row ) == NULL )
+			{
+				WorldChunk* chunk = new WorldChunk;
+				chunk->column = column;
+				chunk->row = row;
+				chunk->state = CHUNK_QUEUED;
+				chunk->surface = NULL;
+				chunk->texture = NULL;
+				mChunks[ row * mChunkColumns + column ] = chunk;
+				requests.push_back( chunk );
+			}
+		}
+	}
+
+	SDL_LockMutex( mLock );
+
+	//Drop queued chunks that scrolled out of range before they were loaded
+	for( int i = 0; i < (int)mQueue.size(); )
+	{
+		WorldChunk* chunk = mQueue[ i ];
+		if( chunk->column < firstColumn || chunk->column > lastColumn || chunk->row < firstRow || chunk->row > lastRow )
+		{
+			mChunks.erase( chunk->row * mChunkColumns + chunk->column );
+			delete chunk;
+			mQueue.erase( mQueue.begin() + i );
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	//Queue the new chunks and load the ones nearest to the camera first
+	mQueue.insert( mQueue.end(), requests.begin(), requests.end() );
+	std::vector< std::pair<Sint64, WorldChunk*> > byDistance;
+	for( int i = 0; i < (int)mQueue.size(); ++i )
+	{
+		byDistance.push_back( std::make_pair( getDistance( mQueue[ i ], centerX, centerY ), mQueue[ i ] ) );
+	}
+	std::sort( byDistance.begin(), byDistance.end() );
+	for( int i = 0; i < (int)byDistance.size(); ++i )
+	{
+		mQueue[ i ] = byDistance[ i ].second;
+	}
+
+	//Take the chunks the loader finished
+	for( int i = 0; i < (int)mPrepared.size(); ++i )
+	{
+		mPrepared[ i ]->state = CHUNK_PREPARED;
+		mUploads.push_back( mPrepared[ i ] );
+	}
+	mPrepared.clear();
 
-//Box collision detector
-bool checkCollision( SDL_Rect a, SDL_Rect b );
+	//Wake the loader
+	if( !mQueue.empty() )
+	{
+		SDL_CondSignal( mHasWork );
+	}
 
-//Checks collision box against set of tiles
-bool touchesWall( SDL_Rect box, Tile* tiles[] );
+	SDL_UnlockMutex( mLock );
 
-//Sets tiles from tile map
-bool setTiles( Tile *tiles[] );
+	//Without a loader thread load a few chunks here
+	if( mThread == NULL )
+	{
+		for( int i = 0; i < UPLOADS_PER_FRAME && !mQueue.empty(); ++i )
+		{
+			WorldChunk* chunk = mQueue.front();
+			mQueue.pop_front();
+			loadChunk( chunk );
+			chunk->state = CHUNK_PREPARED;
+			mUploads.push_back( chunk );
+		}
+	}
 
-//The window we'll be rendering to
-SDL_Window* gWindow = NULL;
+	//Upload a few loaded chunks per frame so uploads don't stall the frame
+	for( int i = 0; i < UPLOADS_PER_FRAME && !mUploads.empty(); ++i )
+	{
+		WorldChunk* chunk = mUploads.front();
+		mUploads.erase( mUploads.begin() );
 
-//The window renderer
-SDL_Renderer* gRenderer = NULL;
+		if( chunk->surface != NULL )
+		{
+			chunk->texture = SDL_CreateTextureFromSurface( gRenderer, chunk->surface );
+			if( chunk->texture != NULL )
+			{
+				mResidentBytes += chunk->surface->w * chunk->surface->h * 4;
+			}
+			SDL_FreeSurface( chunk->surface );
+			chunk->surface = NULL;
+		}
+		mResidentBytes += chunk->tiles.getColumns() * chunk->tiles.getRows();
+		chunk->state = CHUNK_RESIDENT;
+	}
 
-//Scene textures
-LTexture gDotTexture;
-LTexture gTileTexture;
-SDL_Rect gTileClips[ TOTAL_TILE_SPRITES ];
+	//Evict the farthest chunks out of range while over budget
+	while( mResidentBytes > mBudget )
+	{
+		WorldChunk* farthest = NULL;
+		Sint64 farthestDistance = -1;
+		for( std::map<int, WorldChunk*>::iterator it = mChunks.begin(); it != mChunks.end(); ++it )
+		{
+			WorldChunk* chunk = it->second;
+			bool inRange = chunk->column >= firstColumn && chunk->column <= lastColumn && chunk->row >= firstRow && chunk->row <= lastRow;
+			Sint64 distance = getDistance( chunk, centerX, centerY );
+			if( chunk->state == CHUNK_RESIDENT && !inRange && distance > farthestDistance )
+			{
+				farthest = chunk;
+				farthestDistance = distance;
+			}
+		}
 
-LTexture::LTexture()
-{
-	//Initialize
-	mTexture = NULL;
-	mWidth = 0;
-	mHeight = 0;
-}
+		//Everything resident is needed
+		if( farthest == NULL )
+		{
+			break;
+		}
 
-LTexture::~LTexture()
-{
-	//Deallocate
-	free();
+		mChunks.erase( farthest->row * mChunkColumns + farthest->column );
+		deleteChunk( farthest );
+	}
 }
 
-bool LTexture::loadFromFile( std::string path )
+void TileWorld::preload( SDL_Rect& camera )
 {
-	//Get rid of preexisting texture
-	free();
-
-	//The final texture
-	SDL_Texture* newTexture = NULL;
-
-	//Load image at specified path
-	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
-	if( loadedSurface == NULL )
-	{
-		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
-	}
-	else
+	//The chunks under the camera
+	int chunkWidth = CHUNK_TILES * TILE_WIDTH;
+	int chunkHeight = CHUNK_TILES * TILE_HEIGHT;
+	int firstColumn = SDL_max( camera.x / chunkWidth, 0 );
+	int firstRow = SDL_max( camera.y / chunkHeight, 0 );
+	int lastColumn = SDL_min( ( camera.x + camera.w - 1 ) / chunkWidth, mChunkColumns - 1 );
+	int lastRow = SDL_min( ( camera.y + camera.h - 1 ) / chunkHeight, mChunkRows - 1 );
+
+	//Keep streaming until they're all resident
+	bool loaded = false;
+	while( !loaded )
 	{
-		//Color key image
-		SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ) );
+		update( camera );
 
-		//Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
-		if( newTexture == NULL )
+		loaded = true;
+		for( int row = firstRow; row <= lastRow; ++row )
 		{
-			printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+			for( int column = firstColumn; column <= lastColumn; ++column )
+			{
+				WorldChunk* chunk = findChunk( column, row );
+				if( chunk == NULL || chunk->state != CHUNK_RESIDENT )
+				{
+					loaded = false;
+				}
+			}
 		}
-		else
+
+		if( !loaded )
 		{
-			//Get image dimensions
-			mWidth = loadedSurface->w;
-			mHeight = loadedSurface->h;
+			SDL_Delay( 1 );
 		}
-
-		//Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
 	}
-
-	//Return success
-	mTexture = newTexture;
-	return mTexture != NULL;
 }
 
-#ifdef _SDL_TTF_H
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor )
+void TileWorld::render( SDL_Rect& camera )
 {
-	//Get rid of preexisting texture
-	free();
-
-	//Render text surface
-	SDL_Surface* textSurface = TTF_RenderText_Solid( gFont, textureText.c_str(), textColor );
-	if( textSurface != NULL )
+	//The chunks under the camera
+	int chunkWidth = CHUNK_TILES * TILE_WIDTH;
+	int chunkHeight = CHUNK_TILES * TILE_HEIGHT;
+	int firstColumn = SDL_max( camera.x / chunkWidth, 0 );
+	int firstRow = SDL_max( camera.y / chunkHeight, 0 );
+	int lastColumn = SDL_min( ( camera.x + camera.w - 1 ) / chunkWidth, mChunkColumns - 1 );
+	int lastRow = SDL_min( ( camera.y + camera.h - 1 ) / chunkHeight, mChunkRows - 1 );
+
+	for( int row = firstRow; row <= lastRow; ++row )
 	{
-		//Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-		if( mTexture == NULL )
-		{
-			printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
-		}
-		else
+		for( int column = firstColumn; column <= lastColumn; ++column )
 		{
-			//Get image dimensions
-			mWidth = textSurface->w;
-			mHeight = textSurface->h;
+			WorldChunk* chunk = findChunk( column, row );
+			if( chunk == NULL || chunk->state < CHUNK_PREPARED )
+			{
+				//Not loaded yet
+				continue;
+			}
+
+			if( chunk->texture != NULL )
+			{
+				//Show the whole chunk at once
+				SDL_Rect renderQuad = { column * chunkWidth - camera.x, row * chunkHeight - camera.y, chunk->tiles.getColumns() * TILE_WIDTH, chunk->tiles.getRows() * TILE_HEIGHT };
+				SDL_RenderCopy( gRenderer, chunk->texture, NULL, &renderQuad );
+			}
+			else if( chunk->state == CHUNK_RESIDENT )
+			{
+				//The loader couldn't draw the chunk, bake its tiles on the render thread instead
+				SDL_Rect chunkCamera = { camera.x - column * chunkWidth, camera.y - row * chunkHeight, camera.w, camera.h };
+				chunk->tiles.renderChunks( chunkCamera );
+			}
+			else
+			{
+				//Not uploaded yet, show the chunk's tiles
+				SDL_Rect chunkCamera = { camera.x - column * chunkWidth, camera.y - row * chunkHeight, camera.w, camera.h };
+				chunk->tiles.render( chunkCamera );
+			}
 		}
+	}
+}
 
-		//Get rid of old surface
-		SDL_FreeSurface( textSurface );
+bool TileWorld::touchesWall( SDL_Rect box )
+{
+	//Empty boxes and boxes off the map touch nothing
+	if( box.w <= 0 || box.h <= 0 || box.x + box.w <= 0 || box.y + box.h <= 0 || box.x >= getWidth() || box.y >= getHeight() )
+	{
+		return false;
 	}
-	else
+
+	//The chunks the box overlaps
+	int chunkWidth = CHUNK_TILES * TILE_WIDTH;
+	int chunkHeight = CHUNK_TILES * TILE_HEIGHT;
+	int firstColumn = SDL_max( box.x, 0 ) / chunkWidth;
+	int firstRow = SDL_max( box.y, 0 ) / chunkHeight;
+	int lastColumn = SDL_min( ( box.x + box.w - 1 ) / chunkWidth, mChunkColumns - 1 );
+	int lastRow = SDL_min( ( box.y + box.h - 1 ) / chunkHeight, mChunkRows - 1 );
+
+	for( int row = firstRow; row <= lastRow; ++row )
 	{
-		printf( "Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError() );
+		for( int column = firstColumn; column <= lastColumn; ++column )
+		{
+			//Nothing may enter chunks that aren't loaded
+			WorldChunk* chunk = findChunk( column, row );
+			if( chunk == NULL || chunk->state < CHUNK_PREPARED )
+			{
+				return true;
+			}
+
+			//Test the box against the chunk's tiles
+			SDL_Rect chunkBox = { box.x - column * chunkWidth, box.y - row * chunkHeight, box.w, box.h };
+			if( chunk->tiles.touchesWall( chunkBox ) )
+			{
+				return true;
+			}
+		}
 	}
 
-	
-	//Return success
-	return mTexture != NULL;
+	return false;
 }
-#endif
 
-void LTexture::free()
+int TileWorld::touchesWall( SDL_Rect boxes[], int count, bool hits[] )
 {
-	//Free texture if it exists
-	if( mTexture != NULL )
+	//Test each box against the chunks it overlaps
+	int hitCount = 0;
+	for( int i = 0; i < count; ++i )
 	{
-		SDL_DestroyTexture( mTexture );
-		mTexture = NULL;
-		mWidth = 0;
-		mHeight = 0;
+		hits[ i ] = touchesWall( boxes[ i ] );
+		if( hits[ i ] )
+		{
+			++hitCount;
+		}
 	}
+
+	return hitCount;
 }
 
-void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
+int TileWorld::getWidth()
 {
-	//Modulate texture rgb
-	SDL_SetTextureColorMod( mTexture, red, green, blue );
+	return mColumns * TILE_WIDTH;
 }
 
-void LTexture::setBlendMode( SDL_BlendMode blending )
+int TileWorld::getHeight()
 {
-	//Set blending function
-	SDL_SetTextureBlendMode( mTexture, blending );
+	return mRows * TILE_HEIGHT;
 }
-		
-void LTexture::setAlpha( Uint8 alpha )
+
+int TileWorld::getResidentBytes()
 {
-	//Modulate texture alpha
-	SDL_SetTextureAlphaMod( mTexture, alpha );
+	return mResidentBytes;
 }
 
-void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
+void TileWorld::free()
 {
-	//Set rendering space and render to screen
-	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
+	//Stop the loader
+	if( mThread != NULL )
+	{
+		SDL_LockMutex( mLock );
+		mQuit = true;
+		SDL_CondSignal( mHasWork );
+		SDL_UnlockMutex( mLock );
 
-	//Set clip rendering dimensions
-	if( clip != NULL )
+		SDL_WaitThread( mThread, NULL );
+		mThread = NULL;
+	}
+	if( mLock != NULL )
 	{
-		renderQuad.w = clip->w;
-		renderQuad.h = clip->h;
+		SDL_DestroyMutex( mLock );
+		mLock = NULL;
+	}
+	if( mHasWork != NULL )
+	{
+		SDL_DestroyCond( mHasWork );
+		mHasWork = NULL;
 	}
 
-	//Render to screen
-	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
+	//Free chunks
+	for( std::map<int, WorldChunk*>::iterator it = mChunks.begin(); it != mChunks.end(); ++it )
+	{
+		deleteChunk( it->second );
+	}
+	mChunks.clear();
+	mQueue.clear();
+	mPrepared.clear();
+	mUploads.clear();
+	mResidentBytes = 0;
+
+	//Free tile sheet and unmap the map
+	if( mSheet != NULL )
+	{
+		SDL_FreeSurface( mSheet );
+		mSheet = NULL;
+	}
+	mMap.free();
+
+	mColumns = 0;
+	mRows = 0;
+	mChunkColumns = 0;
+	mChunkRows = 0;
 }
 
-int LTexture::getWidth()
+int TileWorld::loaderThread( void* data )
 {
-	return mWidth;
+	//Run the loader of the world passed in
+	( (TileWorld*)data )->runLoader();
+	return 0;
 }
 
-int LTexture::getHeight()
+void TileWorld::runLoader()
 {
-	return mHeight;
+	SDL_LockMutex( mLock );
+	while( !mQuit )
+	{
+		//Wait for work
+		if( mQueue.empty() )
+		{
+			SDL_CondWait( mHasWork, mLock );
+			continue;
+		}
+
+		//Take the nearest chunk, the render thread no longer cancels it
+		WorldChunk* chunk = mQueue.front();
+		mQueue.pop_front();
+
+		//Load without holding the lock
+		SDL_UnlockMutex( mLock );
+		loadChunk( chunk );
+		SDL_LockMutex( mLock );
+
+		//Hand the chunk to the render thread
+		mPrepared.push_back( chunk );
+	}
+	SDL_UnlockMutex( mLock );
 }
 
-Tile::Tile( int x, int y, int tileType )
+void TileWorld::loadChunk( WorldChunk* chunk )
 {
-    //Get the offsets
-    mBox.x = x;
-    mBox.y = y;
-
-    //Set the collision box
-    mBox.w = TILE_WIDTH;
-    mBox.h = TILE_HEIGHT;
+	//Chunks at the right and bottom edges may be partial
+	int firstColumn = chunk->column * CHUNK_TILES;
+	int firstRow = chunk->row * CHUNK_TILES;
+	int columns = SDL_min( CHUNK_TILES, mColumns - firstColumn );
+	int rows = SDL_min( CHUNK_TILES, mRows - firstRow );
+	chunk->tiles.create( columns, rows );
+
+	//Read the chunk's part of each row straight from the mapped level layer
+	Uint8* layer = mMap.getLayer( 0 );
+	for( int row = 0; row < rows; ++row )
+	{
+		Uint8* rowTypes = layer + (size_t)( firstRow + row ) * mColumns + firstColumn;
+		for( int column = 0; column < columns; ++column )
+		{
+			//Unknown tiles are left as the default tile
+			if( rowTypes[ column ] < TOTAL_TILE_SPRITES )
+			{
+				chunk->tiles.setType( column, row, rowTypes[ column ] );
+			}
+		}
+	}
 
-    //Get the tile type
-    mType = tileType;
+	//Draw the chunk's tiles
+	chunk->surface = SDL_CreateRGBSurfaceWithFormat( 0, columns * TILE_WIDTH, rows * TILE_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32 );
+	if( chunk->surface != NULL )
+	{
+		for( int row = 0; row < rows; ++row )
+		{
+			for( int column = 0; column < columns; ++column )
+			{
+				SDL_Rect destination = { column * TILE_WIDTH, row * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT };
+				SDL_BlitSurface( mSheet, &gTileClips[ chunk->tiles.getType( column, row ) ], chunk->surface, &destination );
+			}
+		}
+	}
 }
 
-void Tile::render( SDL_Rect& camera )
+WorldChunk* TileWorld::findChunk( int column, int row )
 {
-    //If the tile is on screen
-    if( checkCollision( camera, mBox ) )
-    {
-        //Show the tile
-        gTileTexture.render( mBox.x - camera.x, mBox.y - camera.y, &gTileClips[ mType ] );
-    }
+	std::map<int, WorldChunk*>::iterator it = mChunks.find( row * mChunkColumns + column );
+	return it != mChunks.end() ? it->second : NULL;
 }
 
-int Tile::getType()
+Sint64 TileWorld::getDistance( WorldChunk* chunk, int x, int y )
 {
-    return mType;
+	//Offset from the chunk's center
+	Sint64 dx = chunk->column * CHUNK_TILES * TILE_WIDTH + CHUNK_TILES * TILE_WIDTH / 2 - x;
+	Sint64 dy = chunk->row * CHUNK_TILES * TILE_HEIGHT + CHUNK_TILES * TILE_HEIGHT / 2 - y;
+	return dx * dx + dy * dy;
 }
 
-SDL_Rect Tile::getBox()
+void TileWorld::deleteChunk( WorldChunk* chunk )
 {
-    return mBox;
+	//Give back the chunk's memory
+	if( chunk->texture != NULL )
+	{
+		mResidentBytes -= chunk->tiles.getColumns() * TILE_WIDTH * chunk->tiles.getRows() * TILE_HEIGHT * 4;
+		SDL_DestroyTexture( chunk->texture );
+	}
+	if( chunk->state == CHUNK_RESIDENT )
+	{
+		mResidentBytes -= chunk->tiles.getColumns() * chunk->tiles.getRows();
+	}
+	if( chunk->surface != NULL )
+	{
+		SDL_FreeSurface( chunk->surface );
+	}
+	delete chunk;
 }
 
 Dot::Dot()
@@ -395,13 +1753,22 @@ void Dot::handleEvent( SDL_Event& e )
     }
 }
 
-void Dot::move( Tile *tiles[] )
+void Dot::move( TileWorld& world )
 {
+    //Test the moves along x, along y, and along both against the walls at once
+    SDL_Rect moves[ 3 ] = { mBox, mBox, mBox };
+    moves[ 0 ].x += mVelX;
+    moves[ 1 ].y += mVelY;
+    moves[ 2 ].x += mVelX;
+    moves[ 2 ].y += mVelY;
+    bool hits[ 3 ];
+    world.touchesWall( moves, 3, hits );
+
     //Move the dot left or right
     mBox.x += mVelX;
 
     //If the dot went too far to the left or right or touched a wall
-    if( ( mBox.x < 0 ) || ( mBox.x + DOT_WIDTH > LEVEL_WIDTH ) || touchesWall( mBox, tiles ) )
+    if( ( mBox.x < 0 ) || ( mBox.x + DOT_WIDTH > world.getWidth() ) || hits[ 0 ] )
     {
         //move back
         mBox.x -= mVelX;
@@ -410,15 +1777,16 @@ void Dot::move( Tile *tiles[] )
     //Move the dot up or down
     mBox.y += mVelY;
 
-    //If the dot went too far up or down or touched a wall
-    if( ( mBox.y < 0 ) || ( mBox.y + DOT_HEIGHT > LEVEL_HEIGHT ) || touchesWall( mBox, tiles ) )
+    //If the dot went too far up or down or touched a wall, after keeping or undoing the move along x
+    bool hitY = mBox.x == moves[ 2 ].x ? hits[ 2 ] : hits[ 1 ];
+    if( ( mBox.y < 0 ) || ( mBox.y + DOT_HEIGHT > world.getHeight() ) || hitY )
     {
         //move back
         mBox.y -= mVelY;
     }
 }
 
-void Dot::setCamera( SDL_Rect& camera )
+void Dot::setCamera( SDL_Rect& camera, TileWorld& world )
 {
 	//Center the camera over the dot
 	camera.x = ( mBox.x + DOT_WIDTH / 2 ) - SCREEN_WIDTH / 2;
@@ -433,13 +1801,13 @@ void Dot::setCamera( SDL_Rect& camera )
 	{
 		camera.y = 0;
 	}
-	if( camera.x > LEVEL_WIDTH - camera.w )
+	if( camera.x > world.getWidth() - camera.w )
 	{
-		camera.x = LEVEL_WIDTH - camera.w;
+		camera.x = world.getWidth() - camera.w;
 	}
-	if( camera.y > LEVEL_HEIGHT - camera.h )
+	if( camera.y > world.getHeight() - camera.h )
 	{
-		camera.y = LEVEL_HEIGHT - camera.h;
+		camera.y = world.getHeight() - camera.h;
 	}
 }
 
@@ -511,7 +1879,7 @@ bool init()
 	return success;
 }
 
-bool loadMedia( Tile* tiles[] )
+bool loadMedia( TileWorld& world )
 {
 	//Loading success flag
 	bool success = true;
@@ -531,7 +1899,7 @@ bool loadMedia( Tile* tiles[] )
 	}
 
 	//Load tile map
-	if( !setTiles( tiles ) )
+	if( !setTiles( world ) )
 	{
 		printf( "Failed to load tile set!\n" );
 		success = false;
@@ -540,17 +1908,10 @@ bool loadMedia( Tile* tiles[] )
 	return success;
 }
 
-void close( Tile* tiles[] )
+void close( TileWorld& world )
 {
 	//Deallocate tiles
-	for( int i = 0; i < TOTAL_TILES; ++i )
-	{
-		 if( tiles[ i ] == NULL )
-		 {
-			delete tiles[ i ];
-			tiles[ i ] = NULL;
-		 }
-	}
+	world.free();
 
 	//Free loaded images
 	gDotTexture.free();
@@ -567,61 +1928,16 @@ void close( Tile* tiles[] )
 	SDL_Quit();
 }
 
-bool checkCollision( SDL_Rect a, SDL_Rect b )
-{
-    //The sides of the rectangles
-    int leftA, leftB;
-    int rightA, rightB;
-    int topA, topB;
-    int bottomA, bottomB;
-
-    //Calculate the sides of rect A
-    leftA = a.x;
-    rightA = a.x + a.w;
-    topA = a.y;
-    bottomA = a.y + a.h;
-
-    //Calculate the sides of rect B
-    leftB = b.x;
-    rightB = b.x + b.w;
-    topB = b.y;
-    bottomB = b.y + b.h;
-
-    //If any of the sides from A are outside of B
-    if( bottomA <= topB )
-    {
-        return false;
-    }
-
-    if( topA >= bottomB )
-    {
-        return false;
-    }
-
-    if( rightA <= leftB )
-    {
-        return false;
-    }
-
-    if( leftA >= rightB )
-    {
-        return false;
-    }
-
-    //If none of the sides from A are outside B
-    return true;
-}
-
-bool setTiles( Tile* tiles[] )
+bool loadTextMap( TileMap& tiles, std::string path )
 {
 	//Success flag
 	bool tilesLoaded = true;
 
-    //The tile offsets
-    int x = 0, y = 0;
+    //Allocate the level
+    tiles.create( LEVEL_WIDTH / TILE_WIDTH, LEVEL_HEIGHT / TILE_HEIGHT );
 
     //Open the map
-    std::ifstream map( "assets/lazy.map" );
+    std::ifstream map( path.c_str() );
 
     //If the map couldn't be loaded
     if(! map )
@@ -652,7 +1968,7 @@ bool setTiles( Tile* tiles[] )
 			//If the number is a valid tile number
 			if( ( tileType >= 0 ) && ( tileType < TOTAL_TILE_SPRITES ) )
 			{
-				tiles[ i ] = new Tile( x, y, tileType );
+				tiles.setType( i % tiles.getColumns(), i / tiles.getColumns(), tileType );
 			}
 			//If we don't recognize the tile type
 			else
@@ -662,83 +1978,6 @@ bool setTiles( Tile* tiles[] )
 				tilesLoaded = false;
 				break;
 			}
-
-			//Move to next tile spot
-			x += TILE_WIDTH;
-
-			//If we've gone too far
-			if( x >= LEVEL_WIDTH )
-			{
-				//Move back
-				x = 0;
-
-				//Move to the next row
-				y += TILE_HEIGHT;
-			}
-		}
-		
-		//Clip the sprite sheet
-		if( tilesLoaded )
-		{
-			gTileClips[ TILE_RED ].x = 0;
-			gTileClips[ TILE_RED ].y = 0;
-			gTileClips[ TILE_RED ].w = TILE_WIDTH;
-			gTileClips[ TILE_RED ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_GREEN ].x = 0;
-			gTileClips[ TILE_GREEN ].y = 80;
-			gTileClips[ TILE_GREEN ].w = TILE_WIDTH;
-			gTileClips[ TILE_GREEN ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_BLUE ].x = 0;
-			gTileClips[ TILE_BLUE ].y = 160;
-			gTileClips[ TILE_BLUE ].w = TILE_WIDTH;
-			gTileClips[ TILE_BLUE ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_TOPLEFT ].x = 80;
-			gTileClips[ TILE_TOPLEFT ].y = 0;
-			gTileClips[ TILE_TOPLEFT ].w = TILE_WIDTH;
-			gTileClips[ TILE_TOPLEFT ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_LEFT ].x = 80;
-			gTileClips[ TILE_LEFT ].y = 80;
-			gTileClips[ TILE_LEFT ].w = TILE_WIDTH;
-			gTileClips[ TILE_LEFT ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_BOTTOMLEFT ].x = 80;
-			gTileClips[ TILE_BOTTOMLEFT ].y = 160;
-			gTileClips[ TILE_BOTTOMLEFT ].w = TILE_WIDTH;
-			gTileClips[ TILE_BOTTOMLEFT ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_TOP ].x = 160;
-			gTileClips[ TILE_TOP ].y = 0;
-			gTileClips[ TILE_TOP ].w = TILE_WIDTH;
-			gTileClips[ TILE_TOP ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_CENTER ].x = 160;
-			gTileClips[ TILE_CENTER ].y = 80;
-			gTileClips[ TILE_CENTER ].w = TILE_WIDTH;
-			gTileClips[ TILE_CENTER ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_BOTTOM ].x = 160;
-			gTileClips[ TILE_BOTTOM ].y = 160;
-			gTileClips[ TILE_BOTTOM ].w = TILE_WIDTH;
-			gTileClips[ TILE_BOTTOM ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_TOPRIGHT ].x = 240;
-			gTileClips[ TILE_TOPRIGHT ].y = 0;
-			gTileClips[ TILE_TOPRIGHT ].w = TILE_WIDTH;
-			gTileClips[ TILE_TOPRIGHT ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_RIGHT ].x = 240;
-			gTileClips[ TILE_RIGHT ].y = 80;
-			gTileClips[ TILE_RIGHT ].w = TILE_WIDTH;
-			gTileClips[ TILE_RIGHT ].h = TILE_HEIGHT;
-
-			gTileClips[ TILE_BOTTOMRIGHT ].x = 240;
-			gTileClips[ TILE_BOTTOMRIGHT ].y = 160;
-			gTileClips[ TILE_BOTTOMRIGHT ].w = TILE_WIDTH;
-			gTileClips[ TILE_BOTTOMRIGHT ].h = TILE_HEIGHT;
 		}
 	}
 
@@ -749,28 +1988,103 @@ bool setTiles( Tile* tiles[] )
     return tilesLoaded;
 }
 
-bool touchesWall( SDL_Rect box, Tile* tiles[] )
+bool convertTextMap( std::string textPath, std::string binaryPath )
 {
-    //Go through the tiles
-    for( int i = 0; i < TOTAL_TILES; ++i )
-    {
-        //If the tile is a wall type tile
-        if( ( tiles[ i ]->getType() >= TILE_CENTER ) && ( tiles[ i ]->getType() <= TILE_TOPLEFT ) )
-        {
-            //If the collision box touches the wall tile
-            if( checkCollision( box, tiles[ i ]->getBox() ) )
-            {
-                return true;
-            }
-        }
-    }
+	//Parse the text map and write it back out
+	TileMap tiles;
+	return loadTextMap( tiles, textPath ) && tiles.saveToFile( binaryPath );
+}
+
+bool setTiles( TileWorld& world )
+{
+	//Success flag
+	bool tilesLoaded = true;
+
+	//Clip the sprite sheet
+	gTileClips[ TILE_RED ].x = 0;
+	gTileClips[ TILE_RED ].y = 0;
+	gTileClips[ TILE_RED ].w = TILE_WIDTH;
+	gTileClips[ TILE_RED ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_GREEN ].x = 0;
+	gTileClips[ TILE_GREEN ].y = 80;
+	gTileClips[ TILE_GREEN ].w = TILE_WIDTH;
+	gTileClips[ TILE_GREEN ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_BLUE ].x = 0;
+	gTileClips[ TILE_BLUE ].y = 160;
+	gTileClips[ TILE_BLUE ].w = TILE_WIDTH;
+	gTileClips[ TILE_BLUE ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_TOPLEFT ].x = 80;
+	gTileClips[ TILE_TOPLEFT ].y = 0;
+	gTileClips[ TILE_TOPLEFT ].w = TILE_WIDTH;
+	gTileClips[ TILE_TOPLEFT ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_LEFT ].x = 80;
+	gTileClips[ TILE_LEFT ].y = 80;
+	gTileClips[ TILE_LEFT ].w = TILE_WIDTH;
+	gTileClips[ TILE_LEFT ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_BOTTOMLEFT ].x = 80;
+	gTileClips[ TILE_BOTTOMLEFT ].y = 160;
+	gTileClips[ TILE_BOTTOMLEFT ].w = TILE_WIDTH;
+	gTileClips[ TILE_BOTTOMLEFT ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_TOP ].x = 160;
+	gTileClips[ TILE_TOP ].y = 0;
+	gTileClips[ TILE_TOP ].w = TILE_WIDTH;
+	gTileClips[ TILE_TOP ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_CENTER ].x = 160;
+	gTileClips[ TILE_CENTER ].y = 80;
+	gTileClips[ TILE_CENTER ].w = TILE_WIDTH;
+	gTileClips[ TILE_CENTER ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_BOTTOM ].x = 160;
+	gTileClips[ TILE_BOTTOM ].y = 160;
+	gTileClips[ TILE_BOTTOM ].w = TILE_WIDTH;
+	gTileClips[ TILE_BOTTOM ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_TOPRIGHT ].x = 240;
+	gTileClips[ TILE_TOPRIGHT ].y = 0;
+	gTileClips[ TILE_TOPRIGHT ].w = TILE_WIDTH;
+	gTileClips[ TILE_TOPRIGHT ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_RIGHT ].x = 240;
+	gTileClips[ TILE_RIGHT ].y = 80;
+	gTileClips[ TILE_RIGHT ].w = TILE_WIDTH;
+	gTileClips[ TILE_RIGHT ].h = TILE_HEIGHT;
+
+	gTileClips[ TILE_BOTTOMRIGHT ].x = 240;
+	gTileClips[ TILE_BOTTOMRIGHT ].y = 160;
+	gTileClips[ TILE_BOTTOMRIGHT ].w = TILE_WIDTH;
+	gTileClips[ TILE_BOTTOMRIGHT ].h = TILE_HEIGHT;
+
+	//The level is streamed from the binary map, make it from the text map if there isn't one
+	SDL_RWops* binaryMap = SDL_RWFromFile( "assets/lazy.lmap", "rb" );
+	if( binaryMap != NULL )
+	{
+		SDL_RWclose( binaryMap );
+	}
+	else if( !convertTextMap( "assets/lazy.map", "assets/lazy.lmap" ) )
+	{
+		tilesLoaded = false;
+	}
+
+	//Start streaming the level
+	if( tilesLoaded && !world.open( "assets/lazy.lmap", "assets/tiles.png", WORLD_MEMORY_BUDGET ) )
+	{
+		tilesLoaded = false;
+	}
 
-    //If no wall tiles were touched
-    return false;
+    //If the map was loaded fine
+    return tilesLoaded;
 }
+
 		
 //The level tiles
-Tile* tileSet[ TOTAL_TILES ];
+TileWorld tileWorld;
 
 //Main loop flag
 bool quit = false;
@@ -800,18 +2114,18 @@ void loop_handler(void*)
 	}
 
 	//Move the dot
-	dot.move( tileSet );
-	dot.setCamera( camera );
+	dot.move( tileWorld );
+	dot.setCamera( camera, tileWorld );
+
+	//Stream the level around the camera
+	tileWorld.update( camera );
 
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
 	//Render level
-	for( int i = 0; i < TOTAL_TILES; ++i )
-	{
-		tileSet[ i ]->render( camera );
-	}
+	tileWorld.render( camera );
 
 	//Render dot
 	dot.render( camera );
@@ -823,6 +2137,12 @@ void loop_handler(void*)
  
 int main( int argc, char* args[] )
 {
+	//Convert a text map to the binary format instead of running
+	if( argc == 4 && strcmp( args[ 1 ], "--convert-map" ) == 0 )
+	{
+		return convertTextMap( args[ 2 ], args[ 3 ] ) ? 0 : 1;
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -832,12 +2152,16 @@ int main( int argc, char* args[] )
 	{
 
 		//Load media
-		if( !loadMedia( tileSet ) )
+		if( !loadMedia( tileWorld ) )
 		{
 			printf( "Failed to load media!\n" );
 		}
 		else
 		{	
+			//Load the start of the level before the first frame
+			dot.setCamera( camera, tileWorld );
+			tileWorld.preload( camera );
+
 #ifdef _JS
 
                         emscripten_set_main_loop_arg(loop_handler, NULL, -1, 1);
@@ -852,7 +2176,7 @@ int main( int argc, char* args[] )
 		}
 		
 		//Free resources and close SDL
-		close( tileSet );
+		close( tileWorld );
 	}
 
 	return 0;
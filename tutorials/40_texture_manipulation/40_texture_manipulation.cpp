@@ -1,15 +1,24 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2017)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, and strings
+//Using SDL, SDL_image, standard IO, C strings, strings, vectors, and algorithms
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
+#include <algorithm>
 #ifdef _JS
 #include <emscripten.h>
 #endif
 
+//SIMD pixel kernels are built on x86 targets with SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PIXEL_SIMD
+#include <immintrin.h>
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
@@ -77,6 +86,31 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Pixel kernels for locked 32 bit pixels, each touches width pixels of every row and leaves pitch padding alone
+//Replaces pixels matching the color key
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent );
+
+//Multiplies color channels by alpha
+void premultiplyPixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format );
+
+//Multiplies color channels by a tint color
+void tintPixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format, Uint8 red, Uint8 green, Uint8 blue );
+
+//Replaces color channels with their luminance
+void grayscalePixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format );
+
+//Moves channels from one 32 bit format's layout to another's, filling in opaque alpha when the source has none
+void swizzlePixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* from, SDL_PixelFormat* to );
+
+//Checks whether the CPU can run the SIMD pixel kernels
+bool hasPixelSIMD();
+
+//Times the pixel kernels on a large buffer and checks the SIMD paths against the scalar ones
+int benchPixels();
+
+//Whether the pixel kernels use SIMD
+bool gPixelSIMD = hasPixelSIMD();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -400,20 +434,13 @@ bool loadMedia()
 
 			//Get pixel data
 			Uint32* pixels = (Uint32*)gFooTexture.getPixels();
-			int pixelCount = ( gFooTexture.getPitch() / 4 ) * gFooTexture.getHeight();
 
 			//Map colors
 			Uint32 colorKey = SDL_MapRGB( mappingFormat, 0, 0xFF, 0xFF );
 			Uint32 transparent = SDL_MapRGBA( mappingFormat, 0xFF, 0xFF, 0xFF, 0x00 );
 
 			//Color key pixels
-			for( int i = 0; i < pixelCount; ++i )
-			{
-				if( pixels[ i ] == colorKey )
-				{
-					pixels[ i ] = transparent;
-				}
-			}
+			colorKeyPixels( pixels, gFooTexture.getWidth(), gFooTexture.getHeight(), gFooTexture.getPitch(), colorKey, transparent );
 
 			//Unlock texture
 			gFooTexture.unlockTexture();
@@ -426,6 +453,341 @@ bool loadMedia()
 	return success;
 }
 
+bool hasPixelSIMD()
+{
+#ifdef PIXEL_SIMD
+	return SDL_HasSSE2();
+#else
+	return false;
+#endif
+}
+
+//Multiplies each byte of a pixel by the matching byte of a multiplier, as if both were 0 to 1
+static inline Uint32 multiplyChannels( Uint32 pixel, Uint32 multiplier )
+{
+	Uint32 result = 0;
+	for( int shift = 0; shift < 32; shift += 8 )
+	{
+		//Rounded division by 255
+		Uint32 product = ( ( pixel >> shift ) & 0xFF ) * ( ( multiplier >> shift ) & 0xFF ) + 128;
+		result |= ( ( product + ( product >> 8 ) ) >> 8 ) << shift;
+	}
+
+	return result;
+}
+
+#ifdef PIXEL_SIMD
+//Multiplies the bytes of four pixels like multiplyChannels
+static inline __m128i multiplyChannelsSSE2( __m128i pixels, __m128i multipliers )
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i rounding = _mm_set1_epi16( 128 );
+
+	__m128i low = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( pixels, zero ), _mm_unpacklo_epi8( multipliers, zero ) ), rounding );
+	__m128i high = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( pixels, zero ), _mm_unpackhi_epi8( multipliers, zero ) ), rounding );
+	low = _mm_srli_epi16( _mm_add_epi16( low, _mm_srli_epi16( low, 8 ) ), 8 );
+	high = _mm_srli_epi16( _mm_add_epi16( high, _mm_srli_epi16( high, 8 ) ), 8 );
+
+	return _mm_packus_epi16( low, high );
+}
+#endif
+
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent )
+{
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		if( gPixelSIMD )
+		{
+			//Select between the pixel and transparent without branching
+			__m128i key = _mm_set1_epi32( (int)colorKey );
+			__m128i clear = _mm_set1_epi32( (int)transparent );
+			for( ; x + 4 <= width; x += 4 )
+			{
+				__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+				__m128i keyed = _mm_cmpeq_epi32( color, key );
+				_mm_storeu_si128( (__m128i*)( row + x ), _mm_or_si128( _mm_and_si128( keyed, clear ), _mm_andnot_si128( keyed, color ) ) );
+			}
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			if( row[ x ] == colorKey )
+			{
+				row[ x ] = transparent;
+			}
+		}
+	}
+}
+
+void premultiplyPixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format )
+{
+	//Opaque formats are already premultiplied
+	if( format->Amask == 0 )
+	{
+		return;
+	}
+
+	//Alpha and padding bytes are multiplied by one
+	Uint32 colorMask = format->Rmask | format->Gmask | format->Bmask;
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		if( gPixelSIMD )
+		{
+			__m128i alphaShift = _mm_cvtsi32_si128( format->Ashift );
+			__m128i byteMask = _mm_set1_epi32( 0xFF );
+			__m128i colors = _mm_set1_epi32( (int)colorMask );
+			__m128i others = _mm_set1_epi32( (int)~colorMask );
+			for( ; x + 4 <= width; x += 4 )
+			{
+				//Spread each pixel's alpha over its color bytes
+				__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+				__m128i alpha = _mm_and_si128( _mm_srl_epi32( color, alphaShift ), byteMask );
+				alpha = _mm_or_si128( alpha, _mm_slli_epi32( alpha, 8 ) );
+				alpha = _mm_or_si128( alpha, _mm_slli_epi32( alpha, 16 ) );
+				__m128i multipliers = _mm_or_si128( _mm_and_si128( alpha, colors ), others );
+				_mm_storeu_si128( (__m128i*)( row + x ), multiplyChannelsSSE2( color, multipliers ) );
+			}
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			Uint32 alpha = ( row[ x ] >> format->Ashift ) & 0xFF;
+			row[ x ] = multiplyChannels( row[ x ], ( alpha * 0x01010101 & colorMask ) | ~colorMask );
+		}
+	}
+}
+
+void tintPixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format, Uint8 red, Uint8 green, Uint8 blue )
+{
+	//Alpha and padding bytes are multiplied by one
+	Uint32 multiplier = ( red << format->Rshift ) | ( green << format->Gshift ) | ( blue << format->Bshift ) | ~( format->Rmask | format->Gmask | format->Bmask );
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		if( gPixelSIMD )
+		{
+			__m128i multipliers = _mm_set1_epi32( (int)multiplier );
+			for( ; x + 4 <= width; x += 4 )
+			{
+				__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+				_mm_storeu_si128( (__m128i*)( row + x ), multiplyChannelsSSE2( color, multipliers ) );
+			}
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			row[ x ] = multiplyChannels( row[ x ], multiplier );
+		}
+	}
+}
+
+void grayscalePixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* format )
+{
+	//Alpha and padding bytes are kept
+	Uint32 keepMask = ~( format->Rmask | format->Gmask | format->Bmask );
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		if( gPixelSIMD )
+		{
+			__m128i redShift = _mm_cvtsi32_si128( format->Rshift );
+			__m128i greenShift = _mm_cvtsi32_si128( format->Gshift );
+			__m128i blueShift = _mm_cvtsi32_si128( format->Bshift );
+			__m128i byteMask = _mm_set1_epi32( 0xFF );
+			__m128i keep = _mm_set1_epi32( (int)keepMask );
+			for( ; x + 4 <= width; x += 4 )
+			{
+				//Channels fit in the low 16 bits of each lane so 16 bit multiplies are enough
+				__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+				__m128i r = _mm_and_si128( _mm_srl_epi32( color, redShift ), byteMask );
+				__m128i g = _mm_and_si128( _mm_srl_epi32( color, greenShift ), byteMask );
+				__m128i b = _mm_and_si128( _mm_srl_epi32( color, blueShift ), byteMask );
+				__m128i luma = _mm_add_epi32( _mm_mullo_epi16( r, _mm_set1_epi32( 77 ) ), _mm_mullo_epi16( g, _mm_set1_epi32( 150 ) ) );
+				luma = _mm_add_epi32( luma, _mm_mullo_epi16( b, _mm_set1_epi32( 29 ) ) );
+				luma = _mm_srli_epi32( _mm_add_epi32( luma, _mm_set1_epi32( 128 ) ), 8 );
+
+				__m128i gray = _mm_or_si128( _mm_sll_epi32( luma, redShift ), _mm_sll_epi32( luma, greenShift ) );
+				gray = _mm_or_si128( gray, _mm_sll_epi32( luma, blueShift ) );
+				_mm_storeu_si128( (__m128i*)( row + x ), _mm_or_si128( gray, _mm_and_si128( color, keep ) ) );
+			}
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			Uint32 r = ( row[ x ] >> format->Rshift ) & 0xFF;
+			Uint32 g = ( row[ x ] >> format->Gshift ) & 0xFF;
+			Uint32 b = ( row[ x ] >> format->Bshift ) & 0xFF;
+			Uint32 luma = ( 77 * r + 150 * g + 29 * b + 128 ) >> 8;
+			row[ x ] = ( row[ x ] & keepMask ) | ( luma << format->Rshift ) | ( luma << format->Gshift ) | ( luma << format->Bshift );
+		}
+	}
+}
+
+void swizzlePixels( Uint32* pixels, int width, int height, int pitch, SDL_PixelFormat* from, SDL_PixelFormat* to )
+{
+	//Where each channel comes from and goes to, alpha comes from nowhere when the source has none
+	int fromShifts[ 4 ] = { from->Rshift, from->Gshift, from->Bshift, from->Amask != 0 ? from->Ashift : -1 };
+	int toShifts[ 4 ] = { to->Rshift, to->Gshift, to->Bshift, to->Amask != 0 ? to->Ashift : -1 };
+
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		if( gPixelSIMD )
+		{
+			__m128i byteMask = _mm_set1_epi32( 0xFF );
+			for( ; x + 4 <= width; x += 4 )
+			{
+				__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+				__m128i moved = _mm_setzero_si128();
+				for( int c = 0; c < 4; ++c )
+				{
+					if( toShifts[ c ] < 0 )
+					{
+						continue;
+					}
+
+					__m128i channel = fromShifts[ c ] < 0 ? byteMask : _mm_and_si128( _mm_srl_epi32( color, _mm_cvtsi32_si128( fromShifts[ c ] ) ), byteMask );
+					moved = _mm_or_si128( moved, _mm_sll_epi32( channel, _mm_cvtsi32_si128( toShifts[ c ] ) ) );
+				}
+				_mm_storeu_si128( (__m128i*)( row + x ), moved );
+			}
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			Uint32 moved = 0;
+			for( int c = 0; c < 4; ++c )
+			{
+				if( toShifts[ c ] >= 0 )
+				{
+					Uint32 channel = fromShifts[ c ] < 0 ? 0xFF : ( row[ x ] >> fromShifts[ c ] ) & 0xFF;
+					moved |= channel << toShifts[ c ];
+				}
+			}
+			row[ x ] = moved;
+		}
+	}
+}
+
+int benchPixels()
+{
+	//A sprite sheet sized buffer with an odd width and padded rows
+	const int WIDTH = 4099;
+	const int HEIGHT = 1024;
+	const int PITCH = ( WIDTH + 5 ) * 4;
+	const int BENCH_RUNS = 20;
+	const int WORDS = PITCH / 4 * HEIGHT;
+
+	SDL_PixelFormat* rgba = SDL_AllocFormat( SDL_PIXELFORMAT_RGBA8888 );
+	SDL_PixelFormat* argb = SDL_AllocFormat( SDL_PIXELFORMAT_ARGB8888 );
+	if( rgba == NULL || argb == NULL )
+	{
+		printf( "Unable to allocate pixel formats! SDL Error: %s\n", SDL_GetError() );
+		return 1;
+	}
+
+	//Random pixels with some matching the color key
+	Uint32 colorKey = SDL_MapRGB( rgba, 0, 0xFF, 0xFF );
+	Uint32 transparent = SDL_MapRGBA( rgba, 0xFF, 0xFF, 0xFF, 0x00 );
+	std::vector<Uint32> source( WORDS );
+	for( int i = 0; i < WORDS; ++i )
+	{
+		source[ i ] = rand() % 4 == 0 ? colorKey : ( (Uint32)rand() << 16 ) ^ (Uint32)rand();
+	}
+
+	const char* names[ 5 ] = { "color key", "premultiply", "tint", "grayscale", "swizzle" };
+	bool simd = gPixelSIMD;
+	bool success = true;
+	for( int k = 0; k < 5; ++k )
+	{
+		//Run the kernel with and without SIMD, timing each
+		std::vector<Uint32> results[ 2 ];
+		double times[ 2 ] = { 0.0, 0.0 };
+		for( int pass = 0; pass < 2; ++pass )
+		{
+			gPixelSIMD = pass == 1 && simd;
+			results[ pass ] = source;
+
+			Uint64 start = SDL_GetPerformanceCounter();
+			for( int run = 0; run < BENCH_RUNS; ++run )
+			{
+				//Every run works on the original pixels
+				if( run > 0 )
+				{
+					std::copy( source.begin(), source.end(), results[ pass ].begin() );
+				}
+
+				Uint32* pixels = &results[ pass ][ 0 ];
+				switch( k )
+				{
+					case 0: colorKeyPixels( pixels, WIDTH, HEIGHT, PITCH, colorKey, transparent ); break;
+					case 1: premultiplyPixels( pixels, WIDTH, HEIGHT, PITCH, rgba ); break;
+					case 2: tintPixels( pixels, WIDTH, HEIGHT, PITCH, rgba, 0xFF, 0x80, 0x20 ); break;
+					case 3: grayscalePixels( pixels, WIDTH, HEIGHT, PITCH, rgba ); break;
+					case 4: swizzlePixels( pixels, WIDTH, HEIGHT, PITCH, rgba, argb ); break;
+				}
+			}
+			times[ pass ] = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency() / BENCH_RUNS;
+		}
+
+		//Padding must be untouched and both paths must agree
+		int mismatches = 0;
+		for( int y = 0; y < HEIGHT; ++y )
+		{
+			for( int x = WIDTH; x < PITCH / 4; ++x )
+			{
+				if( results[ 0 ][ y * PITCH / 4 + x ] != source[ y * PITCH / 4 + x ] )
+				{
+					++mismatches;
+				}
+			}
+		}
+		if( results[ 0 ] != results[ 1 ] )
+		{
+			++mismatches;
+		}
+
+		printf( "%-12s  scalar %7.3f ms  SIMD %7.3f ms  %5.2fx  %s\n", names[ k ], times[ 0 ], times[ 1 ], times[ 0 ] / times[ 1 ], mismatches == 0 ? "matches scalar" : "MISMATCH" );
+		if( mismatches != 0 )
+		{
+			success = false;
+		}
+	}
+	gPixelSIMD = simd;
+
+	SDL_FreeFormat( rgba );
+	SDL_FreeFormat( argb );
+
+	return success ? 0 : 1;
+}
+
 void close()
 {
 	//Free loaded images
@@ -474,6 +836,12 @@ void loop_handler(void*)
  
 int main( int argc, char* args[] )
 {
+	//Compare the pixel kernels instead of running the demo
+	if( argc > 1 && strcmp( args[ 1 ], "--bench" ) == 0 )
+	{
+		return benchPixels();
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -1,15 +1,26 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, SDL_ttf, standard IO, math, strings, and string streams
+//Using SDL, SDL_image, SDL_ttf, standard IO, math, file info, strings, string streams, file streams, vectors, algorithms, and maps
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <map>
 #ifdef _JS
 #include <emscripten.h>
 #endif
 
+//Font scanning and color keying compare pixels four at a time on x86 targets with SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define FONT_SIMD
+#include <immintrin.h>
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
@@ -58,6 +69,9 @@ class LTexture
 		int getPitch();
 		Uint32 getPixel32( unsigned int x, unsigned int y );
 
+		//Gets the hardware texture
+		SDL_Texture* getTexture();
+
 	private:
 		//The actual hardware texture
 		SDL_Texture* mTexture;
@@ -76,12 +90,26 @@ class LBitmapFont
 		//The default constructor
 		LBitmapFont();
 
-		//Generates the font
-		bool buildFont( LTexture *bitmap );
+		//Generates the font, reusing the glyph metrics cached at cachePath while the image file at imagePath is unchanged
+		bool buildFont( LTexture *bitmap, std::string imagePath = "", std::string cachePath = "" );
 
 		//Shows the text
 		void renderText( int x, int y, std::string text );
 
+		//Sets how much closer or further apart two characters are drawn
+		void setKerning( char first, char second, int offset );
+		int getKerning( char first, char second );
+
+		//Gets the clip of a character in the bitmap
+		SDL_Rect getClip( char c );
+
+		//Gets spacing
+		int getSpace();
+		int getNewLine();
+
+		//Gets the font texture
+		LTexture* getBitmap();
+
     private:
 		//The font texture
 		LTexture* mBitmap;
@@ -91,6 +119,72 @@ class LBitmapFont
 
 		//Spacing Variables
 		int mNewLine, mSpace;
+
+		//Spacing adjustments keyed by both characters
+		std::map<int, int> mKerning;
+
+		//Finds the glyph bounds in the locked bitmap
+		void scanGlyphs( LTexture* bitmap );
+
+		//Loads the cached metrics if they were found from the same image file, unchanged since
+		bool loadCache( std::string cachePath, std::string imagePath );
+
+		//Saves the metrics so the image doesn't have to be scanned again
+		void saveCache( std::string cachePath, std::string imagePath );
+
+		//Gets a file's size and last modification time, false if it doesn't exist
+		static bool getFileInfo( std::string path, long& size, long& modified );
+};
+
+//Text laid out once into glyph quads that are drawn with a single geometry call
+class LTextLayout
+{
+	public:
+		//Initializes variables
+		LTextLayout();
+
+		//Lays out text in a font, wrapping words onto new lines past wrapWidth pixels when it's positive
+		void setText( LBitmapFont& font, std::string text, int wrapWidth = 0 );
+
+		//Shows the laid out text
+		void render( int x, int y );
+
+		//Gets laid out dimensions
+		int getWidth();
+		int getHeight();
+
+		//Gets number of laid out glyphs
+		int getGlyphCount();
+
+	private:
+		//A character placed relative to the top left of the text
+		struct LayoutGlyph
+		{
+			SDL_Rect clip;
+			int x;
+			int y;
+		};
+
+		//The font the text was laid out in
+		LBitmapFont* mFont;
+
+		//The placed characters
+		std::vector<LayoutGlyph> mGlyphs;
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+		//Four vertices and six indices per glyph, with the text at the origin
+		std::vector<SDL_Vertex> mVertices;
+		std::vector<int> mIndices;
+
+		//Copy of the vertices moved to where the text was last drawn
+		std::vector<SDL_Vertex> mPlacedVertices;
+		int mVertexX;
+		int mVertexY;
+#endif
+
+		//Laid out dimensions
+		int mWidth;
+		int mHeight;
 };
 
 //Starts up SDL and creates window
@@ -102,6 +196,12 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Replaces pixels matching the color key in width pixels of every row, leaving pitch padding alone
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent );
+
+//Marks which pixels in a row differ from the background color in a per column mask, returns whether any did
+bool scanFontRow( const Uint32* row, int width, Uint32 bgColor, Uint32* columns );
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -112,6 +212,10 @@ SDL_Renderer* gRenderer = NULL;
 LTexture gBitmapTexture;
 LBitmapFont gBitmapFont;
 
+//Laid out text
+LTextLayout gTestText;
+LTextLayout gWrappedText;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -175,20 +279,13 @@ bool LTexture::loadFromFile( std::string path )
 
 				//Get pixel data in editable format
 				Uint32* pixels = (Uint32*)mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
 
 				//Map colors				
 				Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
 				Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
 
 				//Color key pixels
-				for( int i = 0; i < pixelCount; ++i )
-				{
-					if( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				colorKeyPixels( pixels, mWidth, mHeight, mPitch, colorKey, transparent );
 
 				//Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -366,6 +463,11 @@ Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
     return pixels[ ( y * ( mPitch / 4 ) ) + x ];
 }
 
+SDL_Texture* LTexture::getTexture()
+{
+	return mTexture;
+}
+
 LBitmapFont::LBitmapFont()
 {
     //Initialize variables
@@ -374,171 +476,217 @@ LBitmapFont::LBitmapFont()
     mSpace = 0;
 }
 
-bool LBitmapFont::buildFont( LTexture* bitmap )
+bool LBitmapFont::buildFont( LTexture* bitmap, std::string imagePath, std::string cachePath )
 {
 	bool success = true;
-	
+
+	//Use the cached metrics without touching the pixels if they were found from the same image file
+	bool cached = imagePath != "" && cachePath != "";
+	if( cached && loadCache( cachePath, imagePath ) )
+	{
+		mBitmap = bitmap;
+	}
 	//Lock pixels for access
-	if( !bitmap->lockTexture() )
+	else if( !bitmap->lockTexture() )
 	{
 		printf( "Unable to lock bitmap font texture!\n" );
 		success = false;
 	}
 	else
 	{
-		//Set the background color
-		Uint32 bgColor = bitmap->getPixel32( 0, 0 );
+		//Find the glyphs
+		scanGlyphs( bitmap );
+
+		//Save them for next time
+		if( cached )
+		{
+			saveCache( cachePath, imagePath );
+		}
+
+		bitmap->unlockTexture();
+		mBitmap = bitmap;
+	}
 
-		//Set the cell dimensions
-		int cellW = bitmap->getWidth() / 16;
-		int cellH = bitmap->getHeight() / 16;
+	return success;
+}
 
-		//New line variables
-		int top = cellH;
-		int baseA = cellH;
+void LBitmapFont::scanGlyphs( LTexture* bitmap )
+{
+	//Get pixel data in editable format
+	Uint32* pixels = (Uint32*)bitmap->getPixels();
+	int pitch = bitmap->getPitch() / 4;
 
-		//The current character we're setting
-		int currentChar = 0;
+	//Set the background color
+	Uint32 bgColor = pixels[ 0 ];
 
-		//Go through the cell rows
-		for( int rows = 0; rows < 16; ++rows )
-		{
-			//Go through the cell columns
-			for( int cols = 0; cols < 16; ++cols )
-			{
-				//Set the character offset
-				mChars[ currentChar ].x = cellW * cols;
-				mChars[ currentChar ].y = cellH * rows;
+	//Set the cell dimensions
+	int cellW = bitmap->getWidth() / 16;
+	int cellH = bitmap->getHeight() / 16;
+
+	//New line variables
+	int top = cellH;
+	int baseA = cellH;
 
-				//Set the dimensions of the character
-				mChars[ currentChar ].w = cellW;
-				mChars[ currentChar ].h = cellH;
+	//Which columns of the current cell have glyph pixels
+	std::vector<Uint32> columns( cellW + 1 );
 
-				//Find Left Side
-				//Go through pixel columns
-				for( int pCol = 0; pCol < cellW; ++pCol )
+	//The current character we're setting
+	int currentChar = 0;
+
+	//Go through the cell rows
+	for( int rows = 0; rows < 16; ++rows )
+	{
+		//Go through the cell columns
+		for( int cols = 0; cols < 16; ++cols )
+		{
+			//Set the character offset
+			mChars[ currentChar ].x = cellW * cols;
+			mChars[ currentChar ].y = cellH * rows;
+
+			//Set the dimensions of the character
+			mChars[ currentChar ].w = cellW;
+			mChars[ currentChar ].h = cellH;
+
+			//Mark the occupied rows and columns in one pass over the cell
+			std::fill( columns.begin(), columns.end(), 0 );
+			int firstRow = -1, lastRow = -1;
+			for( int pRow = 0; pRow < cellH; ++pRow )
+			{
+				const Uint32* row = pixels + ( cellH * rows + pRow ) * pitch + cellW * cols;
+				if( scanFontRow( row, cellW, bgColor, &columns[ 0 ] ) )
 				{
-					//Go through pixel rows
-					for( int pRow = 0; pRow < cellH; ++pRow )
+					if( firstRow == -1 )
 					{
-						//Get the pixel offsets
-						int pX = ( cellW * cols ) + pCol;
-						int pY = ( cellH * rows ) + pRow;
-
-						//If a non colorkey pixel is found
-						if( bitmap->getPixel32( pX, pY ) != bgColor )
-						{
-							//Set the x offset
-							mChars[ currentChar ].x = pX;
-
-							//Break the loops
-							pCol = cellW;
-							pRow = cellH;
-						}
+						firstRow = pRow;
 					}
+					lastRow = pRow;
 				}
+			}
 
-				//Find Right Side
-				//Go through pixel columns
-				for( int pColW = cellW - 1; pColW >= 0; --pColW )
+			//Empty cells keep the whole cell
+			if( firstRow != -1 )
+			{
+				//Find Left and Right Sides
+				int left = 0;
+				while( columns[ left ] == 0 )
 				{
-					//Go through pixel rows
-					for( int pRowW = 0; pRowW < cellH; ++pRowW )
-					{
-						//Get the pixel offsets
-						int pX = ( cellW * cols ) + pColW;
-						int pY = ( cellH * rows ) + pRowW;
-
-						//If a non colorkey pixel is found
-						if( bitmap->getPixel32( pX, pY ) != bgColor )
-						{
-							//Set the width
-							mChars[ currentChar ].w = ( pX - mChars[ currentChar ].x ) + 1;
-
-							//Break the loops
-							pColW = -1;
-							pRowW = cellH;
-						}
-					}
+					++left;
 				}
+				int right = cellW - 1;
+				while( columns[ right ] == 0 )
+				{
+					--right;
+				}
+				mChars[ currentChar ].x = cellW * cols + left;
+				mChars[ currentChar ].w = right - left + 1;
 
 				//Find Top
-				//Go through pixel rows
-				for( int pRow = 0; pRow < cellH; ++pRow )
+				if( firstRow < top )
 				{
-					//Go through pixel columns
-					for( int pCol = 0; pCol < cellW; ++pCol )
-					{
-						//Get the pixel offsets
-						int pX = ( cellW * cols ) + pCol;
-						int pY = ( cellH * rows ) + pRow;
-
-						//If a non colorkey pixel is found
-						if( bitmap->getPixel32( pX, pY ) != bgColor )
-						{
-							//If new top is found
-							if( pRow < top )
-							{
-								top = pRow;
-							}
-
-							//Break the loops
-							pCol = cellW;
-							pRow = cellH;
-						}
-					}
+					top = firstRow;
 				}
 
 				//Find Bottom of A
 				if( currentChar == 'A' )
 				{
-					//Go through pixel rows
-					for( int pRow = cellH - 1; pRow >= 0; --pRow )
-					{
-						//Go through pixel columns
-						for( int pCol = 0; pCol < cellW; ++pCol )
-						{
-							//Get the pixel offsets
-							int pX = ( cellW * cols ) + pCol;
-							int pY = ( cellH * rows ) + pRow;
-
-							//If a non colorkey pixel is found
-							if( bitmap->getPixel32( pX, pY ) != bgColor )
-							{
-								//Bottom of a is found
-								baseA = pRow;
-
-								//Break the loops
-								pCol = cellW;
-								pRow = -1;
-							}
-						}
-					}
+					baseA = lastRow;
 				}
-
-				//Go to the next character
-				++currentChar;
 			}
+
+			//Go to the next character
+			++currentChar;
 		}
+	}
 
-		//Calculate space
-		mSpace = cellW / 2;
+	//Calculate space
+	mSpace = cellW / 2;
 
-		//Calculate new line
-		mNewLine = baseA - top;
+	//Calculate new line
+	mNewLine = baseA - top;
 
-		//Lop off excess top pixels
-		for( int i = 0; i < 256; ++i )
-		{
-			mChars[ i ].y += top;
-			mChars[ i ].h -= top;
-		}
+	//Lop off excess top pixels
+	for( int i = 0; i < 256; ++i )
+	{
+		mChars[ i ].y += top;
+		mChars[ i ].h -= top;
+	}
+}
 
-		bitmap->unlockTexture();
-		mBitmap = bitmap;
+bool LBitmapFont::loadCache( std::string cachePath, std::string imagePath )
+{
+	//Open the metrics
+	std::ifstream metrics( cachePath.c_str() );
+	if( !metrics )
+	{
+		return false;
 	}
 
-	return success;
+	//The metrics must be for the same image file, unchanged since it was scanned
+	std::string cachedPath;
+	long cachedSize = 0, cachedModified = 0, size = 0, modified = 0;
+	SDL_Rect chars[ 256 ];
+	int newLine = 0, space = 0;
+	metrics >> cachedPath >> cachedSize >> cachedModified >> newLine >> space;
+	if( metrics.fail() || cachedPath != imagePath || !getFileInfo( imagePath, size, modified ) || cachedSize != size || cachedModified != modified )
+	{
+		return false;
+	}
+
+	//Read each character's clip
+	for( int i = 0; i < 256; ++i )
+	{
+		metrics >> chars[ i ].x >> chars[ i ].y >> chars[ i ].w >> chars[ i ].h;
+	}
+	if( metrics.fail() )
+	{
+		return false;
+	}
+
+	//Use the cached metrics
+	for( int i = 0; i < 256; ++i )
+	{
+		mChars[ i ] = chars[ i ];
+	}
+	mNewLine = newLine;
+	mSpace = space;
+	return true;
+}
+
+void LBitmapFont::saveCache( std::string cachePath, std::string imagePath )
+{
+	//Metrics that can't be checked against the image aren't worth saving
+	long size = 0, modified = 0;
+	if( !getFileInfo( imagePath, size, modified ) )
+	{
+		return;
+	}
+
+	std::ofstream metrics( cachePath.c_str() );
+	if( !metrics )
+	{
+		printf( "Unable to save font metrics %s!\n", cachePath.c_str() );
+		return;
+	}
+
+	metrics << imagePath << " " << size << " " << modified << " " << mNewLine << " " << mSpace << "\n";
+	for( int i = 0; i < 256; ++i )
+	{
+		metrics << mChars[ i ].x << " " << mChars[ i ].y << " " << mChars[ i ].w << " " << mChars[ i ].h << "\n";
+	}
+}
+
+bool LBitmapFont::getFileInfo( std::string path, long& size, long& modified )
+{
+	//Get the file's info
+	struct stat info;
+	if( stat( path.c_str(), &info ) != 0 )
+	{
+		return false;
+	}
+
+	size = (long)info.st_size;
+	modified = (long)info.st_mtime;
+	return true;
 }
 
 void LBitmapFont::renderText( int x, int y, std::string text )
@@ -582,6 +730,298 @@ void LBitmapFont::renderText( int x, int y, std::string text )
     }
 }
 
+bool scanFontRow( const Uint32* row, int width, Uint32 bgColor, Uint32* columns )
+{
+	Uint32 any = 0;
+	int x = 0;
+
+#ifdef FONT_SIMD
+	//Compare four pixels at a time
+	__m128i background = _mm_set1_epi32( (int)bgColor );
+	__m128i anyVector = _mm_setzero_si128();
+	for( ; x + 4 <= width; x += 4 )
+	{
+		__m128i pixels = _mm_loadu_si128( (const __m128i*)( row + x ) );
+		__m128i differs = _mm_xor_si128( _mm_cmpeq_epi32( pixels, background ), _mm_set1_epi32( -1 ) );
+		__m128i marked = _mm_loadu_si128( (const __m128i*)( columns + x ) );
+		_mm_storeu_si128( (__m128i*)( columns + x ), _mm_or_si128( marked, differs ) );
+		anyVector = _mm_or_si128( anyVector, differs );
+	}
+	any = _mm_movemask_epi8( anyVector );
+#endif
+
+	//Finish the pixels left over
+	for( ; x < width; ++x )
+	{
+		Uint32 differs = row[ x ] != bgColor ? 0xFFFFFFFF : 0;
+		columns[ x ] |= differs;
+		any |= differs;
+	}
+
+	return any != 0;
+}
+
+void LBitmapFont::setKerning( char first, char second, int offset )
+{
+	mKerning[ ( (unsigned char)first << 8 ) | (unsigned char)second ] = offset;
+}
+
+int LBitmapFont::getKerning( char first, char second )
+{
+	//Most pairs aren't adjusted
+	if( mKerning.empty() )
+	{
+		return 0;
+	}
+
+	std::map<int, int>::iterator found = mKerning.find( ( (unsigned char)first << 8 ) | (unsigned char)second );
+	return found != mKerning.end() ? found->second : 0;
+}
+
+SDL_Rect LBitmapFont::getClip( char c )
+{
+	return mChars[ (unsigned char)c ];
+}
+
+int LBitmapFont::getSpace()
+{
+	return mSpace;
+}
+
+int LBitmapFont::getNewLine()
+{
+	return mNewLine;
+}
+
+LTexture* LBitmapFont::getBitmap()
+{
+	return mBitmap;
+}
+
+LTextLayout::LTextLayout()
+{
+	//Initialize
+	mFont = NULL;
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	mVertexX = 0;
+	mVertexY = 0;
+#endif
+	mWidth = 0;
+	mHeight = 0;
+}
+
+void LTextLayout::setText( LBitmapFont& font, std::string text, int wrapWidth )
+{
+	//Start over
+	mFont = &font;
+	mGlyphs.clear();
+	mWidth = 0;
+	mHeight = 0;
+
+	//Temp offsets
+	int curX = 0, curY = 0;
+
+	//Go through the text a word at a time
+	int i = 0;
+	while( i < (int)text.length() )
+	{
+		//If the current character is a space
+		if( text[ i ] == ' ' )
+		{
+			//Move over
+			curX += font.getSpace();
+			++i;
+			continue;
+		}
+
+		//If the current character is a newline
+		if( text[ i ] == '\n' )
+		{
+			//Move down and back
+			curY += font.getNewLine();
+			curX = 0;
+			++i;
+			continue;
+		}
+
+		//Measure the word
+		int end = i;
+		int wordWidth = 0;
+		while( end < (int)text.length() && text[ end ] != ' ' && text[ end ] != '\n' )
+		{
+			if( end > i )
+			{
+				wordWidth += font.getKerning( text[ end - 1 ], text[ end ] );
+			}
+			wordWidth += font.getClip( text[ end ] ).w + 1;
+			++end;
+		}
+
+		//Start a new line if the word would run past the wrap width
+		if( wrapWidth > 0 && curX > 0 && curX + wordWidth - 1 > wrapWidth )
+		{
+			curY += font.getNewLine();
+			curX = 0;
+		}
+
+		//Place the word's characters
+		for( int j = i; j < end; ++j )
+		{
+			if( j > i )
+			{
+				curX += font.getKerning( text[ j - 1 ], text[ j ] );
+			}
+
+			LayoutGlyph glyph;
+			glyph.clip = font.getClip( text[ j ] );
+			glyph.x = curX;
+			glyph.y = curY;
+			mGlyphs.push_back( glyph );
+
+			//Move over the width of the character with one pixel of padding
+			curX += glyph.clip.w + 1;
+			mWidth = SDL_max( mWidth, curX - 1 );
+			mHeight = SDL_max( mHeight, curY + glyph.clip.h );
+		}
+		i = end;
+	}
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Build the quads at the origin, a moved copy is made when drawn elsewhere
+	mVertices.clear();
+	mIndices.clear();
+	mPlacedVertices.clear();
+	mVertexX = 0;
+	mVertexY = 0;
+	LTexture* bitmap = font.getBitmap();
+	if( bitmap == NULL )
+	{
+		return;
+	}
+
+	for( int g = 0; g < (int)mGlyphs.size(); ++g )
+	{
+		LayoutGlyph& glyph = mGlyphs[ g ];
+
+		//Texture coordinates of the character
+		float u0 = (float)glyph.clip.x / bitmap->getWidth();
+		float v0 = (float)glyph.clip.y / bitmap->getHeight();
+		float u1 = (float)( glyph.clip.x + glyph.clip.w ) / bitmap->getWidth();
+		float v1 = (float)( glyph.clip.y + glyph.clip.h ) / bitmap->getHeight();
+
+		//Corners of the quad
+		float cornerX[ 4 ] = { 0.f, (float)glyph.clip.w, (float)glyph.clip.w, 0.f };
+		float cornerY[ 4 ] = { 0.f, 0.f, (float)glyph.clip.h, (float)glyph.clip.h };
+		float cornerU[ 4 ] = { u0, u1, u1, u0 };
+		float cornerV[ 4 ] = { v0, v0, v1, v1 };
+
+		//Queue the two triangles of the quad
+		int first = mVertices.size();
+		for( int c = 0; c < 4; ++c )
+		{
+			SDL_Vertex vertex;
+			vertex.position.x = glyph.x + cornerX[ c ];
+			vertex.position.y = glyph.y + cornerY[ c ];
+			vertex.color.r = 0xFF;
+			vertex.color.g = 0xFF;
+			vertex.color.b = 0xFF;
+			vertex.color.a = 0xFF;
+			vertex.tex_coord.x = cornerU[ c ];
+			vertex.tex_coord.y = cornerV[ c ];
+			mVertices.push_back( vertex );
+		}
+
+		mIndices.push_back( first );
+		mIndices.push_back( first + 1 );
+		mIndices.push_back( first + 2 );
+		mIndices.push_back( first );
+		mIndices.push_back( first + 2 );
+		mIndices.push_back( first + 3 );
+	}
+	mPlacedVertices = mVertices;
+#endif
+}
+
+void LTextLayout::render( int x, int y )
+{
+	//If the text has been laid out
+	if( mFont == NULL || mFont->getBitmap() == NULL )
+	{
+		return;
+	}
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+	//Place the quads again from the origin only when the text moved, so moving never adds up rounding error
+	if( x != mVertexX || y != mVertexY )
+	{
+		for( int i = 0; i < (int)mVertices.size(); ++i )
+		{
+			mPlacedVertices[ i ].position.x = mVertices[ i ].position.x + x;
+			mPlacedVertices[ i ].position.y = mVertices[ i ].position.y + y;
+		}
+		mVertexX = x;
+		mVertexY = y;
+	}
+
+	//Draw every character at once
+	if( !mIndices.empty() )
+	{
+		SDL_RenderGeometry( gRenderer, mFont->getBitmap()->getTexture(), &mPlacedVertices[ 0 ], mPlacedVertices.size(), &mIndices[ 0 ], mIndices.size() );
+	}
+#else
+	//No geometry rendering, draw each character
+	for( int i = 0; i < (int)mGlyphs.size(); ++i )
+	{
+		mFont->getBitmap()->render( x + mGlyphs[ i ].x, y + mGlyphs[ i ].y, &mGlyphs[ i ].clip );
+	}
+#endif
+}
+
+int LTextLayout::getWidth()
+{
+	return mWidth;
+}
+
+int LTextLayout::getHeight()
+{
+	return mHeight;
+}
+
+int LTextLayout::getGlyphCount()
+{
+	return mGlyphs.size();
+}
+
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent )
+{
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef FONT_SIMD
+		//Select between the pixel and transparent without branching
+		__m128i key = _mm_set1_epi32( (int)colorKey );
+		__m128i clear = _mm_set1_epi32( (int)transparent );
+		for( ; x + 4 <= width; x += 4 )
+		{
+			__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+			__m128i keyed = _mm_cmpeq_epi32( color, key );
+			_mm_storeu_si128( (__m128i*)( row + x ), _mm_or_si128( _mm_and_si128( keyed, clear ), _mm_andnot_si128( keyed, color ) ) );
+		}
+#endif
+
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			if( row[ x ] == colorKey )
+			{
+				row[ x ] = transparent;
+			}
+		}
+	}
+}
+
 bool init()
 {
 	//Initialization flag
@@ -661,7 +1101,18 @@ bool loadMedia()
 	else
 	{
 		//Build font from texture
-		gBitmapFont.buildFont( &gBitmapTexture );
+		gBitmapFont.buildFont( &gBitmapTexture, "assets/lazyfont.png", "assets/lazyfont.metrics" );
+
+		//Pull in pairs that look loose
+		gBitmapFont.setKerning( 'A', 'V', -2 );
+		gBitmapFont.setKerning( 'V', 'A', -2 );
+		gBitmapFont.setKerning( 'A', 'W', -2 );
+		gBitmapFont.setKerning( 'W', 'A', -2 );
+		gBitmapFont.setKerning( 'T', 'o', -2 );
+
+		//Lay out text once
+		gTestText.setText( gBitmapFont, "Bitmap Font:\nABDCEFGHIJKLMNOPQRSTUVWXYZ\nabcdefghijklmnopqrstuvwxyz\n0123456789" );
+		gWrappedText.setText( gBitmapFont, "Wrapped and kerned: To WAVE AWAY the quick brown fox jumps over the lazy dog.", SCREEN_WIDTH );
 	}
 
 	return success;
@@ -706,7 +1157,8 @@ void loop_handler(void*)
 	SDL_RenderClear( gRenderer );
 
 	//Render test text
-	gBitmapFont.renderText( 0, 0, "Bitmap Font:\nABDCEFGHIJKLMNOPQRSTUVWXYZ\nabcdefghijklmnopqrstuvwxyz\n0123456789" );
+	gTestText.render( 0, 0 );
+	gWrappedText.render( 0, SCREEN_HEIGHT - gWrappedText.getHeight() );
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -5,15 +5,25 @@ and may not be redistributed without written permission.*/
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #ifdef _JS
 #include <emscripten.h>
 #endif
 
+//Color keying compares pixels four at a time on x86 targets with SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PIXEL_SIMD
+#include <immintrin.h>
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//How long each frame of the animation stream is shown
+const Uint32 STREAM_FRAME_TICKS = 1000 / 15;
+
 //Texture wrapper class
 class LTexture
 {
@@ -59,6 +69,7 @@ class LTexture
 		bool unlockTexture();
 		void* getPixels();
 		void copyPixels( void* pixels );
+		void updateRows( void* pixels, int pitch, int top, int bottom );
 		int getPitch();
 		Uint32 getPixel32( unsigned int x, unsigned int y );
 
@@ -73,27 +84,82 @@ class LTexture
 		int mHeight;
 };
 
-//A test animation stream
+//A staging buffer frames are decoded into and uploaded from
+struct StreamFrame
+{
+	//Decoded pixels
+	SDL_Surface* surface;
+
+	//The animation image in the buffer
+	int image;
+};
+
+//A test animation stream decoded on its own thread
 class DataStream
 {
 	public:
+		//Number of staging buffers, one being decoded, one ready and one being uploaded
+		static const int STREAM_BUFFERS = 3;
+
+		//Marks the ready buffer as not taken yet
+		static const int FRAME_FRESH = 4;
+
 		//Initializes internals
 		DataStream();
 
-		//Loads initial data
+		//Loads initial data and starts the producer
 		bool loadMedia();
 
-		//Deallocator
+		//Stops the producer and deallocates
 		void free();
 
-		//Gets current frame data
-		void* getBuffer();
+		//Decodes the frame due on this thread when the producer thread couldn't start
+		void update();
+
+		//Takes the newest decoded frame and the rows that changed since the last frame taken, NULL if there's nothing new
+		//Never blocks, the frame belongs to the caller until the next call
+		StreamFrame* acquireFrame( int& dirtyTop, int& dirtyBottom );
 
 	private:
+		//Producer thread entry point
+		static int producerThread( void* data );
+
+		//Decodes frames as they come due until the stream is freed
+		void runProducer();
+
+		//Decodes the newest frame due by the given time, returns ticks until the next one is due
+		Uint32 produce( Uint32 now );
+
+		//Decodes an animation image into a staging buffer
+		void decode( StreamFrame& frame, int image );
+
 		//Internal data
 		SDL_Surface* mImages[ 4 ];
-		int mCurrentImage;
-		int mDelayFrames;
+
+		//Rows that differ between each pair of images
+		int mChangedTop[ 4 ][ 4 ];
+		int mChangedBottom[ 4 ][ 4 ];
+
+		//The staging buffers
+		StreamFrame mFrames[ STREAM_BUFFERS ];
+
+		//The buffer the producer owns, the one the render loop owns and the one between them with its fresh flag
+		int mWriteFrame;
+		int mReadFrame;
+		SDL_atomic_t mReadyFrame;
+
+		//When the stream started and the next frame to decode
+		Uint32 mStartTicks;
+		Uint32 mNextFrame;
+
+		//The last image taken, -1 before the first
+		int mTakenImage;
+
+		//The producer thread and what wakes it to quit
+		SDL_Thread* mThread;
+		SDL_mutex* mLock;
+		SDL_cond* mWake;
+		bool mQuit;
 };
 
 //Starts up SDL and creates window
@@ -105,6 +171,9 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Replaces pixels matching the color key in width pixels of every row, leaving pitch padding alone
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent );
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -180,20 +249,13 @@ bool LTexture::loadFromFile( std::string path )
 
 				//Get pixel data in editable format
 				Uint32* pixels = (Uint32*)mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
 
 				//Map colors				
 				Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
 				Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
 
 				//Color key pixels
-				for( int i = 0; i < pixelCount; ++i )
-				{
-					if( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+				colorKeyPixels( pixels, mWidth, mHeight, mPitch, colorKey, transparent );
 
 				//Unlock texture to update
 				SDL_UnlockTexture( newTexture );
@@ -384,6 +446,16 @@ void LTexture::copyPixels( void* pixels )
 	}
 }
 
+void LTexture::updateRows( void* pixels, int pitch, int top, int bottom )
+{
+	//Upload just the rows given, straight from the caller's pixels
+	if( mTexture != NULL && top < bottom )
+	{
+		SDL_Rect rows = { 0, top, mWidth, bottom - top };
+		SDL_UpdateTexture( mTexture, &rows, (Uint8*)pixels + top * pitch, pitch );
+	}
+}
+
 int LTexture::getPitch()
 {
 	return mPitch;
@@ -405,8 +477,23 @@ DataStream::DataStream()
 	mImages[ 2 ] = NULL;
 	mImages[ 3 ] = NULL;
 
-	mCurrentImage = 0;
-	mDelayFrames = 4;
+	for( int i = 0; i < STREAM_BUFFERS; ++i )
+	{
+		mFrames[ i ].surface = NULL;
+		mFrames[ i ].image = -1;
+	}
+	mWriteFrame = 0;
+	mReadFrame = 1;
+	SDL_AtomicSet( &mReadyFrame, 2 );
+
+	mStartTicks = 0;
+	mNextFrame = 0;
+	mTakenImage = -1;
+
+	mThread = NULL;
+	mLock = NULL;
+	mWake = NULL;
+	mQuit = false;
 }
 
 bool DataStream::loadMedia()
@@ -432,32 +519,236 @@ bool DataStream::loadMedia()
 		SDL_FreeSurface( loadedSurface );
 	}
 
+	if( success )
+	{
+		//Find the rows each change of image touches
+		for( int from = 0; from < 4; ++from )
+		{
+			for( int to = 0; to < 4; ++to )
+			{
+				int top = mImages[ to ]->h, bottom = 0;
+				for( int y = 0; y < mImages[ to ]->h; ++y )
+				{
+					Uint8* fromRow = (Uint8*)mImages[ from ]->pixels + y * mImages[ from ]->pitch;
+					Uint8* toRow = (Uint8*)mImages[ to ]->pixels + y * mImages[ to ]->pitch;
+					if( memcmp( fromRow, toRow, mImages[ to ]->w * 4 ) != 0 )
+					{
+						top = SDL_min( top, y );
+						bottom = y + 1;
+					}
+				}
+				mChangedTop[ from ][ to ] = top;
+				mChangedBottom[ from ][ to ] = bottom;
+			}
+		}
+
+		//Allocate the staging buffers
+		for( int i = 0; i < STREAM_BUFFERS; ++i )
+		{
+			mFrames[ i ].surface = SDL_CreateRGBSurfaceWithFormat( 0, mImages[ 0 ]->w, mImages[ 0 ]->h, 32, SDL_PIXELFORMAT_RGBA8888 );
+			if( mFrames[ i ].surface == NULL )
+			{
+				printf( "Unable to create staging buffer! SDL Error: %s\n", SDL_GetError() );
+				success = false;
+			}
+		}
+	}
+
+	if( success )
+	{
+		//Start the producer
+		mStartTicks = SDL_GetTicks();
+		mNextFrame = 0;
+		mLock = SDL_CreateMutex();
+		mWake = SDL_CreateCond();
+		mQuit = false;
+		if( mLock == NULL || mWake == NULL )
+		{
+			printf( "Unable to create producer lock, frames decode on the render thread! SDL Error: %s\n", SDL_GetError() );
+		}
+		else
+		{
+			mThread = SDL_CreateThread( producerThread, "DataStream", this );
+			if( mThread == NULL )
+			{
+				printf( "Unable to create producer thread, frames decode on the render thread! SDL Error: %s\n", SDL_GetError() );
+			}
+		}
+	}
+
 	return success;
 }
 
 void DataStream::free()
 {
+	//Stop the producer
+	if( mThread != NULL )
+	{
+		SDL_LockMutex( mLock );
+		mQuit = true;
+		SDL_CondSignal( mWake );
+		SDL_UnlockMutex( mLock );
+
+		SDL_WaitThread( mThread, NULL );
+		mThread = NULL;
+	}
+	if( mLock != NULL )
+	{
+		SDL_DestroyMutex( mLock );
+		mLock = NULL;
+	}
+	if( mWake != NULL )
+	{
+		SDL_DestroyCond( mWake );
+		mWake = NULL;
+	}
+
 	for( int i = 0; i < 4; ++i )
 	{
 		SDL_FreeSurface( mImages[ i ] );
+		mImages[ i ] = NULL;
+	}
+
+	for( int i = 0; i < STREAM_BUFFERS; ++i )
+	{
+		SDL_FreeSurface( mFrames[ i ].surface );
+		mFrames[ i ].surface = NULL;
+		mFrames[ i ].image = -1;
+	}
+	mWriteFrame = 0;
+	mReadFrame = 1;
+	SDL_AtomicSet( &mReadyFrame, 2 );
+	mTakenImage = -1;
+}
+
+void DataStream::update()
+{
+	//The producer thread does this when it's running
+	if( mThread == NULL && mFrames[ 0 ].surface != NULL )
+	{
+		produce( SDL_GetTicks() );
+	}
+}
+
+StreamFrame* DataStream::acquireFrame( int& dirtyTop, int& dirtyBottom )
+{
+	//Nothing new since the last frame taken
+	if( ( SDL_AtomicGet( &mReadyFrame ) & FRAME_FRESH ) == 0 )
+	{
+		return NULL;
+	}
+
+	//Swap the buffer we're done with for the newest one, the producer only ever makes it fresher
+	//SDL_AtomicSet alone doesn't order the pixels on every platform, so fence both sides of the swap
+	SDL_MemoryBarrierRelease();
+	mReadFrame = SDL_AtomicSet( &mReadyFrame, mReadFrame ) & ~FRAME_FRESH;
+	SDL_MemoryBarrierAcquire();
+	StreamFrame* frame = &mFrames[ mReadFrame ];
+
+	//Everything is dirty the first time, after that only the rows that differ from the last frame taken
+	if( mTakenImage == -1 )
+	{
+		dirtyTop = 0;
+		dirtyBottom = frame->surface->h;
+	}
+	else
+	{
+		dirtyTop = mChangedTop[ mTakenImage ][ frame->image ];
+		dirtyBottom = mChangedBottom[ mTakenImage ][ frame->image ];
+	}
+	mTakenImage = frame->image;
+
+	return frame;
+}
+
+int DataStream::producerThread( void* data )
+{
+	//Run the producer of the stream passed in
+	( (DataStream*)data )->runProducer();
+	return 0;
+}
+
+void DataStream::runProducer()
+{
+	SDL_LockMutex( mLock );
+	while( !mQuit )
+	{
+		//Decode without holding the lock
+		SDL_UnlockMutex( mLock );
+		Uint32 wait = produce( SDL_GetTicks() );
+		SDL_LockMutex( mLock );
+
+		//Sleep until the next frame is due or we're told to quit
+		if( !mQuit && wait > 0 )
+		{
+			SDL_CondWaitTimeout( mWake, mLock, wait );
+		}
 	}
+	SDL_UnlockMutex( mLock );
 }
 
-void* DataStream::getBuffer()
+Uint32 DataStream::produce( Uint32 now )
 {
-	--mDelayFrames;
-	if( mDelayFrames == 0 )
+	//Frames are due on a fixed schedule from the start of the stream
+	Uint32 due = mStartTicks + mNextFrame * STREAM_FRAME_TICKS;
+	if( now < due )
 	{
-		++mCurrentImage;
-		mDelayFrames = 4;
+		return due - now;
 	}
 
-	if( mCurrentImage == 4 )
+	//Skip frames we're too late for and decode the newest one due
+	Uint32 frameNumber = ( now - mStartTicks ) / STREAM_FRAME_TICKS;
+	StreamFrame& frame = mFrames[ mWriteFrame ];
+	decode( frame, frameNumber % 4 );
+	mNextFrame = frameNumber + 1;
+
+	//Publish it once its pixels are written and take back whichever buffer was waiting, taken or not
+	SDL_MemoryBarrierRelease();
+	mWriteFrame = SDL_AtomicSet( &mReadyFrame, mWriteFrame | FRAME_FRESH ) & ~FRAME_FRESH;
+	SDL_MemoryBarrierAcquire();
+
+	return mStartTicks + mNextFrame * STREAM_FRAME_TICKS - now;
+}
+
+void DataStream::decode( StreamFrame& frame, int image )
+{
+	//Copy the image's rows into the buffer
+	SDL_Surface* source = mImages[ image ];
+	for( int y = 0; y < source->h; ++y )
 	{
-		mCurrentImage = 0;
+		memcpy( (Uint8*)frame.surface->pixels + y * frame.surface->pitch, (Uint8*)source->pixels + y * source->pitch, source->w * 4 );
 	}
+	frame.image = image;
+}
+
+void colorKeyPixels( Uint32* pixels, int width, int height, int pitch, Uint32 colorKey, Uint32 transparent )
+{
+	for( int y = 0; y < height; ++y )
+	{
+		Uint32* row = (Uint32*)( (Uint8*)pixels + y * pitch );
+		int x = 0;
+
+#ifdef PIXEL_SIMD
+		//Select between the pixel and transparent without branching
+		__m128i key = _mm_set1_epi32( (int)colorKey );
+		__m128i clear = _mm_set1_epi32( (int)transparent );
+		for( ; x + 4 <= width; x += 4 )
+		{
+			__m128i color = _mm_loadu_si128( (__m128i*)( row + x ) );
+			__m128i keyed = _mm_cmpeq_epi32( color, key );
+			_mm_storeu_si128( (__m128i*)( row + x ), _mm_or_si128( _mm_and_si128( keyed, clear ), _mm_andnot_si128( keyed, color ) ) );
+		}
+#endif
 
-	return mImages[ mCurrentImage ]->pixels;
+		//Finish the pixels left over
+		for( ; x < width; ++x )
+		{
+			if( row[ x ] == colorKey )
+			{
+				row[ x ] = transparent;
+			}
+		}
+	}
 }
 
 bool init()
@@ -586,10 +877,16 @@ void loop_handler(void*)
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
-	//Copy frame from buffer
-	gStreamingTexture.lockTexture();
-	gStreamingTexture.copyPixels( gDataStream.getBuffer() );
-	gStreamingTexture.unlockTexture();
+	//Decode the current frame if there's no producer thread
+	gDataStream.update();
+
+	//Upload the rows that changed in the newest frame
+	int dirtyTop = 0, dirtyBottom = 0;
+	StreamFrame* frame = gDataStream.acquireFrame( dirtyTop, dirtyBottom );
+	if( frame != NULL )
+	{
+		gStreamingTexture.updateRows( frame->surface->pixels, frame->surface->pitch, dirtyTop, dirtyBottom );
+	}
 
 	//Render frame
 	gStreamingTexture.render( ( SCREEN_WIDTH - gStreamingTexture.getWidth() ) / 2, ( SCREEN_HEIGHT - gStreamingTexture.getHeight() ) / 2 );
@@ -1,11 +1,15 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, and, strings
+//Using SDL, SDL_image, standard IO, standard library, standard math, strings, and vectors
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
 #include <string>
+#include <vector>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -14,6 +18,18 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Most times a move slides along walls before it stops
+const int MAX_SLIDES = 4;
+
+//How far moving shapes stay from walls they hit
+const float COLLISION_SKIN = 0.01f;
+
+//Simulation steps per second unless --rate says otherwise
+const int SIMULATION_RATE = 120;
+
+//Most steps a frame catches up on before the simulation falls behind instead of stalling
+const int MAX_STEPS_PER_FRAME = 8;
+
 //Texture wrapper class
 class LTexture
 {
@@ -125,14 +141,15 @@ class Dot
 		//Takes key presses and adjusts the dot's velocity
 		void handleEvent( SDL_Event& e );
 
-		//Moves the dot
-		void move( float timeStep );
+		//Moves the dot one step, stopping at walls and sliding along them
+		void move( float timeStep, std::vector<SDL_Rect>& walls );
 
-		//Shows the dot on the screen
-		void render();
+		//Shows the dot the given fraction of the way from its last step to its current one
+		void render( float alpha );
 
     private:
 		float mPosX, mPosY;
+		float mPrevX, mPrevY;
 		float mVelX, mVelY;
 };
 
@@ -145,6 +162,19 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Gets how far into a move a point first enters a box, false if it doesn't during the move
+bool sweepPoint( float x, float y, float moveX, float moveY, float left, float top, float right, float bottom, float& time, float& normalX, float& normalY );
+
+//Gets how far into a move a box first touches a wall and the wall's normal there, false if it doesn't or already overlaps the wall
+bool sweepBox( float x, float y, int w, int h, float moveX, float moveY, SDL_Rect& wall, float& time, float& normalX, float& normalY );
+
+//Gets how far into a move a circle first touches a wall and the wall's normal there, false if it doesn't or already overlaps the wall
+bool sweepCircle( float x, float y, float r, float moveX, float moveY, SDL_Rect& wall, float& time, float& normalX, float& normalY );
+
+//Moves a box or a circle, stopping at the first wall in the way and sliding the rest of the move along it
+void moveAndSlide( float& x, float& y, int w, int h, float moveX, float moveY, std::vector<SDL_Rect>& walls );
+void moveAndSlide( float& x, float& y, float r, float moveX, float moveY, std::vector<SDL_Rect>& walls );
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -550,6 +580,8 @@ Dot::Dot()
     //Initialize the position
     mPosX = 0;
     mPosY = 0;
+    mPrevX = 0;
+    mPrevY = 0;
 
     //Initialize the velocity
     mVelX = 0;
@@ -584,10 +616,14 @@ void Dot::handleEvent( SDL_Event& e )
     }
 }
 
-void Dot::move( float timeStep )
+void Dot::move( float timeStep, std::vector<SDL_Rect>& walls )
 {
-    //Move the dot left or right
-    mPosX += mVelX * timeStep;
+    //Remember where the step started for rendering
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+
+    //Move the whole step at once, walls stop the dot wherever it would hit them
+    moveAndSlide( mPosX, mPosY, DOT_WIDTH, DOT_HEIGHT, mVelX * timeStep, mVelY * timeStep, walls );
 
     //If the dot went too far to the left or right
 	if( mPosX < 0 )
@@ -598,9 +634,6 @@ void Dot::move( float timeStep )
 	{
 		mPosX = SCREEN_WIDTH - DOT_WIDTH;
 	}
-	
-    //Move the dot up or down
-    mPosY += mVelY * timeStep;
 
     //If the dot went too far up or down
 	if( mPosY < 0 )
@@ -613,10 +646,197 @@ void Dot::move( float timeStep )
 	}
 }
 
-void Dot::render()
+void Dot::render( float alpha )
+{
+    //Show the dot between its last two steps
+	float x = mPrevX + ( mPosX - mPrevX ) * alpha;
+	float y = mPrevY + ( mPosY - mPrevY ) * alpha;
+	gDotTexture.render( (int)x, (int)y );
+}
+
+bool sweepPoint( float x, float y, float moveX, float moveY, float left, float top, float right, float bottom, float& time, float& normalX, float& normalY )
+{
+	//Clip the move against the box one axis at a time
+	float enter = -1.f;
+	float exit = 1.f;
+	float starts[ 2 ] = { x, y };
+	float moves[ 2 ] = { moveX, moveY };
+	float lows[ 2 ] = { left, top };
+	float highs[ 2 ] = { right, bottom };
+	int enterAxis = 0;
+	for( int axis = 0; axis < 2; ++axis )
+	{
+		//A point not moving along this axis has to be strictly inside the box on it
+		if( moves[ axis ] == 0.f )
+		{
+			if( starts[ axis ] <= lows[ axis ] || starts[ axis ] >= highs[ axis ] )
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float axisEnter = ( ( moves[ axis ] > 0.f ? lows[ axis ] : highs[ axis ] ) - starts[ axis ] ) / moves[ axis ];
+		float axisExit = ( ( moves[ axis ] > 0.f ? highs[ axis ] : lows[ axis ] ) - starts[ axis ] ) / moves[ axis ];
+		if( axisEnter > enter )
+		{
+			enter = axisEnter;
+			enterAxis = axis;
+		}
+		exit = SDL_min( exit, axisExit );
+	}
+
+	//Grazing an edge or leaving the box isn't entering it
+	if( enter >= exit || exit <= 0.f || enter > 1.f )
+	{
+		return false;
+	}
+
+	//The side entered faces against the move
+	time = enter;
+	normalX = 0.f;
+	normalY = 0.f;
+	if( enterAxis == 0 )
+	{
+		normalX = moveX > 0.f ? -1.f : 1.f;
+	}
+	else
+	{
+		normalY = moveY > 0.f ? -1.f : 1.f;
+	}
+	return true;
+}
+
+bool sweepBox( float x, float y, int w, int h, float moveX, float moveY, SDL_Rect& wall, float& time, float& normalX, float& normalY )
+{
+	//The box touches the wall when its top left corner enters the wall grown by the box's size
+	if( !sweepPoint( x, y, moveX, moveY, wall.x - w, wall.y - h, wall.x + wall.w, wall.y + wall.h, time, normalX, normalY ) )
+	{
+		return false;
+	}
+
+	//A box already inside the wall is left to move out
+	return time >= 0.f;
+}
+
+bool sweepCircle( float x, float y, float r, float moveX, float moveY, SDL_Rect& wall, float& time, float& normalX, float& normalY )
+{
+	//The circle touches the wall when its center enters the wall grown by the radius with rounded corners
+	if( !sweepPoint( x, y, moveX, moveY, wall.x - r, wall.y - r, wall.x + wall.w + r, wall.y + wall.h + r, time, normalX, normalY ) )
+	{
+		return false;
+	}
+
+	//Where the center enters the grown box, or where it starts if it starts inside
+	float enter = SDL_max( time, 0.f );
+	float hitX = x + moveX * enter;
+	float hitY = y + moveY * enter;
+
+	//Along the sides the grown box is the real shape
+	if( ( hitX >= wall.x && hitX <= wall.x + wall.w ) || ( hitY >= wall.y && hitY <= wall.y + wall.h ) )
+	{
+		//A circle already inside the wall is left to move out
+		return time >= 0.f;
+	}
+
+	//Near a corner the shape is a circle around the corner
+	float cornerX = hitX < wall.x ? wall.x : wall.x + wall.w;
+	float cornerY = hitY < wall.y ? wall.y : wall.y + wall.h;
+	float offsetX = x - cornerX;
+	float offsetY = y - cornerY;
+	float c = offsetX * offsetX + offsetY * offsetY - r * r;
+	float a = moveX * moveX + moveY * moveY;
+	float b = offsetX * moveX + offsetY * moveY;
+	float discriminant = b * b - a * c;
+
+	//Starting inside the corner, moving away from it, or missing it
+	if( c <= 0.f || b >= 0.f || discriminant < 0.f )
+	{
+		return false;
+	}
+
+	time = ( -b - sqrtf( discriminant ) ) / a;
+	if( time > 1.f )
+	{
+		return false;
+	}
+
+	//The normal points from the corner to the center
+	normalX = ( offsetX + moveX * time ) / r;
+	normalY = ( offsetY + moveY * time ) / r;
+	return true;
+}
+
+void moveAndSlide( float& x, float& y, int w, int h, float moveX, float moveY, std::vector<SDL_Rect>& walls )
+{
+	for( int slide = 0; slide < MAX_SLIDES && ( moveX != 0.f || moveY != 0.f ); ++slide )
+	{
+		//Find the first wall in the way
+		bool hit = false;
+		float first = 1.f, normalX = 0.f, normalY = 0.f;
+		for( int i = 0; i < (int)walls.size(); ++i )
+		{
+			float time, wallNormalX, wallNormalY;
+			if( sweepBox( x, y, w, h, moveX, moveY, walls[ i ], time, wallNormalX, wallNormalY ) && time <= first )
+			{
+				hit = true;
+				first = time;
+				normalX = wallNormalX;
+				normalY = wallNormalY;
+			}
+		}
+
+		//Move up to the wall, backing off a little so rounding never leaves the box inside it
+		x += moveX * first + normalX * COLLISION_SKIN;
+		y += moveY * first + normalY * COLLISION_SKIN;
+		if( !hit )
+		{
+			break;
+		}
+
+		//Slide the rest of the move along the wall
+		float restX = moveX * ( 1.f - first );
+		float restY = moveY * ( 1.f - first );
+		float into = restX * normalX + restY * normalY;
+		moveX = restX - into * normalX;
+		moveY = restY - into * normalY;
+	}
+}
+
+void moveAndSlide( float& x, float& y, float r, float moveX, float moveY, std::vector<SDL_Rect>& walls )
 {
-    //Show the dot
-	gDotTexture.render( (int)mPosX, (int)mPosY );
+	for( int slide = 0; slide < MAX_SLIDES && ( moveX != 0.f || moveY != 0.f ); ++slide )
+	{
+		//Find the first wall in the way
+		bool hit = false;
+		float first = 1.f, normalX = 0.f, normalY = 0.f;
+		for( int i = 0; i < (int)walls.size(); ++i )
+		{
+			float time, wallNormalX, wallNormalY;
+			if( sweepCircle( x, y, r, moveX, moveY, walls[ i ], time, wallNormalX, wallNormalY ) && time <= first )
+			{
+				hit = true;
+				first = time;
+				normalX = wallNormalX;
+				normalY = wallNormalY;
+			}
+		}
+
+		//Move up to the wall, backing off a little so rounding never leaves the circle inside it
+		x += moveX * first + normalX * COLLISION_SKIN;
+		y += moveY * first + normalY * COLLISION_SKIN;
+		if( !hit )
+		{
+			break;
+		}
+
+		//Slide the rest of the move along the wall
+		float restX = moveX * ( 1.f - first );
+		float restY = moveY * ( 1.f - first );
+		float into = restX * normalX + restY * normalY;
+		moveX = restX - into * normalX;
+		moveY = restY - into * normalY;
+	}
 }
 
 bool init()
@@ -721,6 +941,15 @@ Dot dot;
 //Keeps track of time between steps
 LTimer stepTimer;
 
+//Steps per second, time not stepped yet and when it was last added to
+int simulationRate = SIMULATION_RATE;
+float stepAccumulator = 0.f;
+Uint32 lastStepTicks = 0;
+
+//Thin walls a fast dot would jump over without swept collision
+SDL_Rect wallRects[] = { { 160, 40, 2, 200 }, { 320, 240, 2, 200 }, { 480, 40, 2, 200 }, { 80, 360, 200, 2 } };
+std::vector<SDL_Rect> walls( wallRects, wallRects + sizeof( wallRects ) / sizeof( wallRects[ 0 ] ) );
+
 void loop_handler(void*)
 {
 	//Event handler
@@ -739,21 +968,38 @@ void loop_handler(void*)
 		dot.handleEvent( e );
 	}
 
-	//Calculate time step
-	float timeStep = stepTimer.getTicks() / 1000.f;
+	//Add the time since the last frame without restarting the timer, so no milliseconds are lost
+	Uint32 ticks = stepTimer.getTicks();
+	stepAccumulator += ( ticks - lastStepTicks ) / 1000.f;
+	lastStepTicks = ticks;
 
-	//Move for time step
-	dot.move( timeStep );
+	//Drop time the simulation can't catch up on so a slow frame doesn't make the next one slower
+	float timeStep = 1.f / simulationRate;
+	if( stepAccumulator > MAX_STEPS_PER_FRAME * timeStep )
+	{
+		stepAccumulator = MAX_STEPS_PER_FRAME * timeStep;
+	}
 
-	//Restart step timer
-	stepTimer.start();
+	//Move in fixed steps so the result doesn't depend on the frame rate
+	while( stepAccumulator >= timeStep )
+	{
+		dot.move( timeStep, walls );
+		stepAccumulator -= timeStep;
+	}
 
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
+	//Render walls
+	SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+	for( int i = 0; i < (int)walls.size(); ++i )
+	{
+		SDL_RenderFillRect( gRenderer, &walls[ i ] );
+	}
+
 	//Render dot
-	dot.render();
+	dot.render( stepAccumulator / timeStep );
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );
@@ -762,6 +1008,12 @@ void loop_handler(void*)
  
 int main( int argc, char* args[] )
 {
+	//Take the simulation rate from the command line
+	if( argc > 2 && strcmp( args[ 1 ], "--rate" ) == 0 )
+	{
+		simulationRate = SDL_max( atoi( args[ 2 ] ), 1 );
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -776,6 +1028,9 @@ int main( int argc, char* args[] )
 		}
 		else
 		{	
+			//Start timing steps
+			stepTimer.start();
+
 #ifdef _JS
 
                         emscripten_set_main_loop_arg(loop_handler, NULL, -1, 1);
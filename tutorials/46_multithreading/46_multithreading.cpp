@@ -1,12 +1,15 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2015)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL Threads, SDL_image, standard IO, and, strings
+//Using SDL, SDL Threads, SDL_image, standard IO, strings, and containers
 #include <SDL.h>
 #include <SDL_thread.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
+#include <deque>
 #ifdef _JS
 #include <emscripten.h>
 #endif
@@ -15,6 +18,9 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Milliseconds a frame may spend uploading loaded images
+const double ASSET_UPLOAD_BUDGET = 2.0;
+
 //Texture wrapper class
 class LTexture
 {
@@ -27,6 +33,9 @@ class LTexture
 
 		//Loads image at specified path
 		bool loadFromFile( std::string path );
+
+		//Creates texture from a surface loaded with loadFormattedSurface
+		bool loadFromSurface( SDL_Surface* formattedSurface );
 		
 		#ifdef _SDL_TTF_H
 		//Creates image from font string
@@ -77,6 +86,90 @@ class LTexture
 		int mHeight;
 };
 
+//Handle to an asset queued on the loader
+typedef int AssetHandle;
+
+//Decodes images on worker threads and uploads them to textures on the render thread
+class LAssetLoader
+{
+	public:
+		//Most worker threads images are decoded on
+		static const int MAX_WORKERS = 4;
+
+		//Where an asset is in the pipeline
+		enum AssetState
+		{
+			ASSET_QUEUED,
+			ASSET_DECODING,
+			ASSET_DECODED,
+			ASSET_READY,
+			ASSET_FAILED
+		};
+
+		//Initializes variables
+		LAssetLoader();
+
+		//Stops the workers
+		~LAssetLoader();
+
+		//Starts the workers, images decode on the render thread if they can't be started, call before loading
+		void start();
+
+		//Queues an image to be loaded into a texture and returns its handle
+		AssetHandle load( LTexture* texture, std::string path );
+
+		//Uploads decoded images to their textures until the frame's budget in milliseconds is spent
+		void update( double budget );
+
+		//Gets where an asset is in the pipeline
+		AssetState getState( AssetHandle handle );
+
+		//Gets how much of what was queued is finished, from 0 to 1
+		float getProgress();
+
+		//Checks if everything queued is finished
+		bool isDone();
+
+		//Stops the workers and drops anything not uploaded yet
+		void stop();
+
+	private:
+		//An image and the texture it goes to
+		struct Asset
+		{
+			std::string path;
+			LTexture* texture;
+			SDL_Surface* surface;
+			AssetState state;
+		};
+
+		//Worker thread entry point
+		static int workerThread( void* data );
+
+		//Decodes queued images until the workers stop
+		void runWorker();
+
+		//Decodes the next queued image, the lock is held on entry and exit
+		void decodeNext();
+
+		//Every asset by handle
+		std::vector<Asset> mAssets;
+
+		//Assets waiting for a worker and decoded assets waiting for upload
+		std::deque<AssetHandle> mQueue;
+		std::deque<AssetHandle> mDecoded;
+
+		//Number of assets ready or failed
+		int mFinished;
+
+		//The workers and what guards the assets
+		SDL_Thread* mWorkers[ MAX_WORKERS ];
+		int mWorkerCount;
+		SDL_mutex* mLock;
+		SDL_cond* mHasWork;
+		bool mQuit;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -86,6 +179,9 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+//Loads an image, converts it to the texture format and color keys it, safe to call off the render thread
+SDL_Surface* loadFormattedSurface( std::string path );
+
 //Our test thread function
 int threadFunction( void* data );
 
@@ -98,6 +194,10 @@ SDL_Renderer* gRenderer = NULL;
 //Scene textures
 LTexture gSplashTexture;
 
+//Loads the scene textures in the background
+LAssetLoader gAssetLoader;
+AssetHandle gSplashHandle;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -115,78 +215,55 @@ LTexture::~LTexture()
 }
 
 bool LTexture::loadFromFile( std::string path )
+{
+	//Load and format image at specified path
+	SDL_Surface* formattedSurface = loadFormattedSurface( path );
+	if( formattedSurface == NULL )
+	{
+		free();
+		return false;
+	}
+
+	//Create texture from it
+	bool success = loadFromSurface( formattedSurface );
+	SDL_FreeSurface( formattedSurface );
+
+	//Return success
+	return success;
+}
+
+bool LTexture::loadFromSurface( SDL_Surface* formattedSurface )
 {
 	//Get rid of preexisting texture
 	free();
 
-	//The final texture
-	SDL_Texture* newTexture = NULL;
-
-	//Load image at specified path
-	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
-	if( loadedSurface == NULL )
+	//Create blank streamable texture
+	SDL_Texture* newTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, formattedSurface->w, formattedSurface->h );
+	if( newTexture == NULL )
 	{
-		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
+		printf( "Unable to create blank texture! SDL Error: %s\n", SDL_GetError() );
 	}
 	else
 	{
-		//Convert surface to display format
-		SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0 );
-		if( formattedSurface == NULL )
-		{
-			printf( "Unable to convert loaded surface to display format! %s\n", SDL_GetError() );
-		}
-		else
-		{
-			//Create blank streamable texture
-			newTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, formattedSurface->w, formattedSurface->h );
-			if( newTexture == NULL )
-			{
-				printf( "Unable to create blank texture! SDL Error: %s\n", SDL_GetError() );
-			}
-			else
-			{
-				//Enable blending on texture
-				SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
-
-				//Lock texture for manipulation
-				SDL_LockTexture( newTexture, &formattedSurface->clip_rect, &mPixels, &mPitch );
-
-				//Copy loaded/formatted surface pixels
-				memcpy( mPixels, formattedSurface->pixels, formattedSurface->pitch * formattedSurface->h );
+		//Enable blending on texture
+		SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
 
-				//Get image dimensions
-				mWidth = formattedSurface->w;
-				mHeight = formattedSurface->h;
+		//Lock texture for manipulation
+		SDL_LockTexture( newTexture, &formattedSurface->clip_rect, &mPixels, &mPitch );
 
-				//Get pixel data in editable format
-				Uint32* pixels = (Uint32*)mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
-
-				//Map colors				
-				Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
-				Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
-
-				//Color key pixels
-				for( int i = 0; i < pixelCount; ++i )
-				{
-					if( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
-				}
+		//Copy loaded/formatted surface pixels a row at a time in case the pitches differ
+		for( int y = 0; y < formattedSurface->h; ++y )
+		{
+			memcpy( (Uint8*)mPixels + y * mPitch, (Uint8*)formattedSurface->pixels + y * formattedSurface->pitch, formattedSurface->w * 4 );
+		}
 
-				//Unlock texture to update
-				SDL_UnlockTexture( newTexture );
-				mPixels = NULL;
-			}
+		//Get image dimensions
+		mWidth = formattedSurface->w;
+		mHeight = formattedSurface->h;
 
-			//Get rid of old formatted surface
-			SDL_FreeSurface( formattedSurface );
-		}	
-		
-		//Get rid of old loaded surface
-		SDL_FreeSurface( loadedSurface );
+		//Unlock texture to update
+		SDL_UnlockTexture( newTexture );
+		mPixels = NULL;
 	}
 
 	//Return success
@@ -385,6 +462,219 @@ Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
     return pixels[ ( y * ( mPitch / 4 ) ) + x ];
 }
 
+LAssetLoader::LAssetLoader()
+{
+	//Initialize
+	mFinished = 0;
+	mWorkerCount = 0;
+	mLock = NULL;
+	mHasWork = NULL;
+	mQuit = false;
+}
+
+LAssetLoader::~LAssetLoader()
+{
+	//Stop the workers
+	stop();
+}
+
+void LAssetLoader::start()
+{
+	//Leave a core for the render thread
+	int workerCount = SDL_min( SDL_max( SDL_GetCPUCount() - 1, 1 ), MAX_WORKERS );
+
+	//The lock guards the assets even when there are no workers
+	mLock = SDL_CreateMutex();
+	mHasWork = SDL_CreateCond();
+	mQuit = false;
+	for( int i = 0; i < workerCount; ++i )
+	{
+		mWorkers[ i ] = SDL_CreateThread( workerThread, "AssetLoader", this );
+		if( mWorkers[ i ] == NULL )
+		{
+			printf( "Unable to create asset loader thread! SDL Error: %s\n", SDL_GetError() );
+			break;
+		}
+		mWorkerCount = i + 1;
+	}
+
+	if( mWorkerCount == 0 )
+	{
+		printf( "Images decode on the render thread!\n" );
+	}
+}
+
+AssetHandle LAssetLoader::load( LTexture* texture, std::string path )
+{
+	Asset asset;
+	asset.path = path;
+	asset.texture = texture;
+	asset.surface = NULL;
+	asset.state = ASSET_QUEUED;
+
+	//Queue it for the workers
+	SDL_LockMutex( mLock );
+	AssetHandle handle = mAssets.size();
+	mAssets.push_back( asset );
+	mQueue.push_back( handle );
+	SDL_CondSignal( mHasWork );
+	SDL_UnlockMutex( mLock );
+
+	return handle;
+}
+
+void LAssetLoader::update( double budget )
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 budgetCounts = (Uint64)( budget * SDL_GetPerformanceFrequency() / 1000.0 );
+
+	SDL_LockMutex( mLock );
+
+	//Without workers decode one image a frame here
+	if( mWorkerCount == 0 && !mQueue.empty() )
+	{
+		decodeNext();
+	}
+
+	//Upload at least one image so loading always moves, then stop once the budget is spent
+	bool uploaded = false;
+	while( !mDecoded.empty() && ( !uploaded || SDL_GetPerformanceCounter() - start < budgetCounts ) )
+	{
+		AssetHandle handle = mDecoded.front();
+		mDecoded.pop_front();
+		SDL_Surface* surface = mAssets[ handle ].surface;
+		LTexture* texture = mAssets[ handle ].texture;
+		mAssets[ handle ].surface = NULL;
+
+		//Upload without holding the lock
+		SDL_UnlockMutex( mLock );
+		bool success = texture->loadFromSurface( surface );
+		SDL_FreeSurface( surface );
+		SDL_LockMutex( mLock );
+
+		mAssets[ handle ].state = success ? ASSET_READY : ASSET_FAILED;
+		mFinished++;
+		uploaded = true;
+	}
+
+	SDL_UnlockMutex( mLock );
+}
+
+LAssetLoader::AssetState LAssetLoader::getState( AssetHandle handle )
+{
+	SDL_LockMutex( mLock );
+	AssetState state = mAssets[ handle ].state;
+	SDL_UnlockMutex( mLock );
+
+	return state;
+}
+
+float LAssetLoader::getProgress()
+{
+	SDL_LockMutex( mLock );
+	float progress = mAssets.empty() ? 1.f : (float)mFinished / mAssets.size();
+	SDL_UnlockMutex( mLock );
+
+	return progress;
+}
+
+bool LAssetLoader::isDone()
+{
+	SDL_LockMutex( mLock );
+	bool done = mFinished == (int)mAssets.size();
+	SDL_UnlockMutex( mLock );
+
+	return done;
+}
+
+void LAssetLoader::stop()
+{
+	//Stop the workers
+	if( mLock != NULL )
+	{
+		SDL_LockMutex( mLock );
+		mQuit = true;
+		SDL_CondBroadcast( mHasWork );
+		SDL_UnlockMutex( mLock );
+
+		for( int i = 0; i < mWorkerCount; ++i )
+		{
+			SDL_WaitThread( mWorkers[ i ], NULL );
+			mWorkers[ i ] = NULL;
+		}
+		mWorkerCount = 0;
+
+		SDL_DestroyMutex( mLock );
+		mLock = NULL;
+	}
+	if( mHasWork != NULL )
+	{
+		SDL_DestroyCond( mHasWork );
+		mHasWork = NULL;
+	}
+
+	//Drop images that never made it to a texture
+	for( int i = 0; i < (int)mAssets.size(); ++i )
+	{
+		SDL_FreeSurface( mAssets[ i ].surface );
+	}
+	mAssets.clear();
+	mQueue.clear();
+	mDecoded.clear();
+	mFinished = 0;
+}
+
+int LAssetLoader::workerThread( void* data )
+{
+	//Run a worker of the loader passed in
+	( (LAssetLoader*)data )->runWorker();
+	return 0;
+}
+
+void LAssetLoader::runWorker()
+{
+	SDL_LockMutex( mLock );
+	while( !mQuit )
+	{
+		//Wait for work
+		if( mQueue.empty() )
+		{
+			SDL_CondWait( mHasWork, mLock );
+			continue;
+		}
+
+		decodeNext();
+	}
+	SDL_UnlockMutex( mLock );
+}
+
+void LAssetLoader::decodeNext()
+{
+	//Take the oldest queued image
+	AssetHandle handle = mQueue.front();
+	mQueue.pop_front();
+	mAssets[ handle ].state = ASSET_DECODING;
+	std::string path = mAssets[ handle ].path;
+
+	//Decode without holding the lock
+	SDL_UnlockMutex( mLock );
+	SDL_Surface* surface = loadFormattedSurface( path );
+	SDL_LockMutex( mLock );
+
+	//Hand it to the render thread
+	if( surface == NULL )
+	{
+		mAssets[ handle ].state = ASSET_FAILED;
+		mFinished++;
+	}
+	else
+	{
+		mAssets[ handle ].surface = surface;
+		mAssets[ handle ].state = ASSET_DECODED;
+		mDecoded.push_back( handle );
+	}
+}
+
 bool init()
 {
 	//Initialization flag
@@ -455,19 +745,17 @@ bool loadMedia()
 	//Loading success flag
 	bool success = true;
 	
-	//Load splash texture
-	if( !gSplashTexture.loadFromFile( "assets/splash.png" ) )
-	{
-		printf( "Failed to load splash texture!\n" );
-		success = false;
-	}
+	//Start decoding the splash texture in the background
+	gAssetLoader.start();
+	gSplashHandle = gAssetLoader.load( &gSplashTexture, "assets/splash.png" );
 
 	return success;
 }
 
 void close()
 {
-	//Free loaded images
+	//Stop loading and free loaded images
+	gAssetLoader.stop();
 	gSplashTexture.free();
 
 	//Destroy window	
@@ -489,6 +777,52 @@ int threadFunction( void* data )
 	return 0;
 }
 
+SDL_Surface* loadFormattedSurface( std::string path )
+{
+	//The final surface
+	SDL_Surface* formattedSurface = NULL;
+
+	//Load image at specified path
+	SDL_Surface* loadedSurface = IMG_Load( path.c_str() );
+	if( loadedSurface == NULL )
+	{
+		printf( "Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError() );
+	}
+	else
+	{
+		//Convert surface to display format
+		formattedSurface = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0 );
+		if( formattedSurface == NULL )
+		{
+			printf( "Unable to convert loaded surface to display format! %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Map colors
+			Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
+			Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
+
+			//Color key pixels
+			for( int y = 0; y < formattedSurface->h; ++y )
+			{
+				Uint32* pixels = (Uint32*)( (Uint8*)formattedSurface->pixels + y * formattedSurface->pitch );
+				for( int x = 0; x < formattedSurface->w; ++x )
+				{
+					if( pixels[ x ] == colorKey )
+					{
+						pixels[ x ] = transparent;
+					}
+				}
+			}
+		}
+
+		//Get rid of old loaded surface
+		SDL_FreeSurface( loadedSurface );
+	}
+
+	return formattedSurface;
+}
+
 //Main loop flag
 bool quit = false;
 
@@ -511,12 +845,36 @@ void loop_handler(void*)
 		}
 	}
 
+	//Upload what the loader finished
+	gAssetLoader.update( ASSET_UPLOAD_BUDGET );
+
+	//Quit if the splash couldn't be loaded
+	LAssetLoader::AssetState splashState = gAssetLoader.getState( gSplashHandle );
+	if( splashState == LAssetLoader::ASSET_FAILED )
+	{
+		printf( "Failed to load splash texture!\n" );
+		quit = true;
+		return;
+	}
+
 	//Clear screen
 	SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 	SDL_RenderClear( gRenderer );
 
-	//Render prompt
-	gSplashTexture.render( 0, 0 );
+	//Render prompt once it's loaded
+	if( splashState == LAssetLoader::ASSET_READY )
+	{
+		gSplashTexture.render( 0, 0 );
+	}
+	//Render loading progress
+	else
+	{
+		SDL_Rect outline = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 2 - 10, SCREEN_WIDTH / 2, 20 };
+		SDL_Rect bar = { outline.x, outline.y, (int)( outline.w * gAssetLoader.getProgress() ), outline.h };
+		SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+		SDL_RenderFillRect( gRenderer, &bar );
+		SDL_RenderDrawRect( gRenderer, &outline );
+	}
 
 	//Update screen
 	SDL_RenderPresent( gRenderer );